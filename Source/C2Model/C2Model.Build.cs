@@ -16,7 +16,6 @@ public class C2Model : ModuleRules
 		PublicIncludePaths.AddRange(
 			new string[] {
 				// ... add public include paths required here ...
-    				System.IO.Path.GetFullPath(Target.RelativeEnginePath)+ "Plugins/Experimental/Animation/SkeletalMeshModelingTools/Source/"
 			}
 			);
 				
@@ -38,8 +37,6 @@ public class C2Model : ModuleRules
 			}
 			);
 			
-		PrivateDependencyModuleNames.AddRange(new string[] { "SkeletalMeshModelingTools" });
-		PrivateIncludePathModuleNames.AddRange(new string[] { "SkeletalMeshModelingTools" });
 		PrivateDependencyModuleNames.AddRange(
 			new string[]
 			{
@@ -53,7 +50,6 @@ public class C2Model : ModuleRules
 				"EditorScriptingUtilities",
 				"PhysicsUtilities",
 				"InputCore",
-				"SkeletalMeshModelingTools",
 				"Projects",
 				"UnrealEd",
 				"Slate",
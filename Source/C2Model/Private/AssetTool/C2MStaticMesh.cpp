@@ -12,13 +12,13 @@
 #include "PhysicsAssetUtils.h"
 #include "Utils/C2MUtilsImport.h"
 #include "Rendering/SkinWeightVertexBuffer.h"
-#include "SkeletalMeshModelingTools/Private/SkeletalMeshModelingToolsMeshConverter.h"
 #include "Rendering/SkeletalMeshLODImporterData.h"
 #include "StaticMeshOperations.h"
 #include "Rendering/SkeletalMeshLODModel.h"
 #include "Rendering/SkeletalMeshModel.h"
 #include "EditorFramework/AssetImportData.h"
 #include "Engine/SkinnedAssetCommon.h"
+#include "Async/ParallelFor.h"
 
 /* Create FRawMesh from C2Mesh
  * UNUSED
@@ -26,83 +26,339 @@
 
 
 
-UObject* C2MStaticMesh::CreateMesh(UObject* ParentPackage, FString ModelPackage,C2Mesh* InMesh, const TArray<C2Material*>& CoDMaterials)
+UObject* C2MStaticMesh::CreateMesh(UObject* ParentPackage, FString ModelPackage,const TArray<C2Mesh*>& InLODs, const TArray<C2Material*>& CoDMaterials)
 {
-	FMeshDescription InMeshDescription = CreateMeshDescription(InMesh);
 	if (FPackageName::DoesPackageExist(ModelPackage)) { return nullptr; }
-	UStaticMesh* StaticMesh = Cast<UStaticMesh>(CreateStaticMeshFromMeshDescription(ParentPackage,InMeshDescription,InMesh,CoDMaterials));
 	if (MeshOptions->MeshType == EMeshType::SkeletalMesh)
 	{
-		USkeletalMesh* NewSkeletalMesh = Cast<USkeletalMesh>(CreateSkeletalMeshFromStaticMesh(StaticMesh,InMesh));
+		return CreateSkeletalMesh(ParentPackage, InLODs, CoDMaterials);
+	}
+	// LODs share nothing until they are committed, their descriptions are built side by side
+	TArray<FMeshDescription> MeshDescriptions;
+	MeshDescriptions.SetNum(InLODs.Num());
+	ParallelFor(InLODs.Num(), [&](int32 LODIndex)
+	{
+		MeshDescriptions[LODIndex] = CreateMeshDescription(InLODs[LODIndex]);
+	}, EParallelForFlags::Unbalanced);
+	return CreateStaticMeshFromMeshDescriptions(ParentPackage, MeshDescriptions, InLODs, CoDMaterials);
+}
 
-		StaticMesh->RemoveFromRoot();
-		StaticMesh->MarkAsGarbage();
 
-		return NewSkeletalMesh;
+void C2MStaticMesh::ResolveMaterialSlots(const TArray<C2Mesh*>& InLODs, const TArray<C2Material*>& CoDMaterials, TArray<FMaterialSlot>& OutSlots, TArray<TArray<int32>>& OutSurfaceSlots)
+{
+	TMap<FString, int32> BaseMaterialIndices;
+	for (int32 MaterialIndex = 0; MaterialIndex < CoDMaterials.Num(); MaterialIndex++)
+	{
+		BaseMaterialIndices.FindOrAdd(CoDMaterials[MaterialIndex]->Header->MaterialName, MaterialIndex);
+	}
+	TArray<FString> DroppedMaterials;
+	OutSlots.Reset();
+	OutSurfaceSlots.Reset();
+	OutSurfaceSlots.SetNum(InLODs.Num());
+	for (int32 LODIndex = 0; LODIndex < InLODs.Num(); LODIndex++)
+	{
+		const C2Mesh* LODMesh = InLODs[LODIndex];
+		for (const C2MSurface* Surface : LODMesh->Surfaces)
+		{
+			// Lower LODs have their own material table, move their indices onto CoDMaterials (LOD0's table followed by
+			// the lower LODs' own materials). Without a table (materials not imported) the indices are kept as they are
+			TArray<int32> MaterialIndices;
+			for (const int32 MaterialIndex : Surface->Materials)
+			{
+				if (LODIndex == 0 || BaseMaterialIndices.Num() == 0)
+				{
+					MaterialIndices.Add(MaterialIndex);
+				}
+				else if (const int32* BaseIndex = LODMesh->Materials.IsValidIndex(MaterialIndex) ? BaseMaterialIndices.Find(LODMesh->Materials[MaterialIndex].MaterialName) : nullptr)
+				{
+					MaterialIndices.Add(*BaseIndex);
+				}
+				else
+				{
+					DroppedMaterials.Add(FString::Printf(TEXT("LOD%d %s[%d]"), LODIndex, *Surface->Name, MaterialIndex));
+				}
+			}
+			int32 Slot = INDEX_NONE;
+			if (LODIndex > 0)
+			{
+				Slot = OutSlots.IndexOfByPredicate([&MaterialIndices](const FMaterialSlot& Existing) { return Existing.MaterialIndices == MaterialIndices; });
+			}
+			if (Slot == INDEX_NONE)
+			{
+				const FString SlotName = LODIndex == 0 ? Surface->Name : FString::Printf(TEXT("LOD%d_%s"), LODIndex, *Surface->Name);
+				Slot = OutSlots.Add({ FName(*SlotName), MoveTemp(MaterialIndices) });
+			}
+			OutSurfaceSlots[LODIndex].Add(Slot);
+		}
+	}
+	if (DroppedMaterials.Num() > 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%d surface materials are not in the material table and will be skipped: %s"), DroppedMaterials.Num(), *FString::Join(DroppedMaterials, TEXT(", ")));
 	}
-	return StaticMesh;
 }
 
 
-UObject* C2MStaticMesh::CreateSkeletalMeshFromStaticMesh(UStaticMesh* Mesh, C2Mesh* InMesh)
+UMaterialInterface* C2MStaticMesh::CreateSlotMaterial(UObject* ParentPackage, const FMaterialSlot& Slot, const TArray<C2Material*>& CoDMaterials)
 {
-	USkeleton* Skeleton = nullptr;
-	USkeletalMesh* MeshSkel = nullptr;
-	FReferenceSkeleton RefSkel;
-	CreateSkeleton(InMesh,Mesh->GetName(),Mesh->GetPackage(),RefSkel,Skeleton);
-
-	//
-	IAssetTools& AssetTools = FAssetToolsModule::GetModule().Get();
-	USkeletalMeshFromStaticMeshFactory* SkeletalMeshFactory = NewObject<USkeletalMeshFromStaticMeshFactory>();
-	SkeletalMeshFactory->StaticMesh = Cast<UStaticMesh>(Mesh);
-	SkeletalMeshFactory->ReferenceSkeleton = RefSkel;
-	SkeletalMeshFactory->Skeleton = Skeleton;
-	MeshSkel = Cast<USkeletalMesh>(AssetTools.CreateAsset(Mesh->GetName(), FPackageName::GetLongPackagePath(Mesh->GetPackage()->GetName()), USkeletalMesh::StaticClass(), SkeletalMeshFactory));
-	USkeletalMesh* SkeletalMesh = Cast<USkeletalMesh>(MeshSkel);
-	FMeshDescription DDesc;
-	FSkeletalMeshImportData SkelMeshImportData;
-	SkeletalMesh->LoadLODImportedData(0,SkelMeshImportData);
-	TArray<SkeletalMeshImportData::FRawBoneInfluence> Influences;
-
-	for (size_t i = 0; i < InMesh->Surfaces.Num(); i++)
-	{
-		for (size_t w = 0; w < InMesh->Surfaces[i]->Vertexes.Num(); w++)
+	// Create an array of Surface Materials
+	TArray<C2Material*> SurfMaterials;
+	SurfMaterials.Reserve(Slot.MaterialIndices.Num());
+	for (const int32 MaterialIndex : Slot.MaterialIndices)
+	{
+		if (CoDMaterials.IsValidIndex(MaterialIndex))
+		{
+			SurfMaterials.Push(CoDMaterials[MaterialIndex]);
+		}
+	}
+	if (SurfMaterials.Num() == 0 || !MeshOptions->bImportMaterials)
+	{
+		return UMaterial::GetDefaultMaterial(MD_Surface);
+	}
+	return C2MMaterialInstance::CreateMixMaterialInstance( SurfMaterials,ParentPackage,MeshOptions->OverrideMasterMaterial.LoadSynchronous());
+}
+
+
+void C2MStaticMesh::FillSkeletalImportData(const C2Mesh* InMesh, const C2Mesh* BaseMesh, TArrayView<const int32> SurfaceSlots, FSkeletalMeshImportData& OutImportData)
+{
+	FillBoneImportData(BaseMesh, OutImportData);
+	// Lower LODs carry their own bone table, influences are moved onto the base mesh's bones by name
+	TArray<int32> BoneRemap;
+	if (InMesh != BaseMesh)
+	{
+		TMap<FString, int32> BaseBones;
+		for (int32 BoneIndex = 0; BoneIndex < BaseMesh->Bones.Num(); BoneIndex++)
+		{
+			BaseBones.Add(BaseMesh->Bones[BoneIndex].Name, BoneIndex);
+		}
+		// Bones LOD0 does not have fall back to the root, their influences would otherwise point at nothing
+		FString UnmatchedNames;
+		int32 UnmatchedCount = 0;
+		for (const C2Bone& Bone : InMesh->Bones)
 		{
-			auto weights = InMesh->Surfaces[i]->Vertexes[w].Weights;
-			for (size_t d = 0; d < weights.Num(); d++)
+			const int32* BaseBone = BaseBones.Find(Bone.Name);
+			BoneRemap.Add(BaseBone ? *BaseBone : 0);
+			if (!BaseBone)
 			{
-				auto weight = weights[d];
-				if (weight.WeightValue > 0)
+				UnmatchedNames += (UnmatchedNames.IsEmpty() ? TEXT("") : TEXT(", ")) + Bone.Name;
+				UnmatchedCount++;
+			}
+		}
+		if (UnmatchedCount > 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%d bones of a lower LOD are not in LOD0 and are skinned to the root: %s"), UnmatchedCount, *UnmatchedNames);
+		}
+	}
+
+	// Points are the (optionally welded) positions, each source vertex becomes one wedge shared by the faces using it
+	int32 VertexCount = 0;
+	for (const C2MSurface* Surface : InMesh->Surfaces)
+	{
+		VertexCount += Surface->Positions.Num();
+	}
+	TArray<int32> WeldedVertexIDs;
+	if (MeshOptions->bWeldVertices)
+	{
+		WeldVertices(InMesh, MeshOptions->WeldThreshold, true, WeldedVertexIDs, OutImportData.Points);
+	}
+	const bool bWelded = WeldedVertexIDs.Num() > 0;
+	if (!bWelded)
+	{
+		OutImportData.Points.Reset(VertexCount);
+		for (const C2MSurface* Surface : InMesh->Surfaces)
+		{
+			OutImportData.Points.Append(Surface->Positions.GetData(), Surface->Positions.Num());
+		}
+	}
+
+	OutImportData.NumTexCoords = FMath::Clamp<int32>(InMesh->UVSetCount, 1, MAX_TEXCOORDS);
+	OutImportData.bHasNormals = true;
+	OutImportData.bHasVertexColors = false;
+	OutImportData.bHasTangents = false;
+	OutImportData.MaxMaterialIndex = 0;
+	for (const int32 Slot : SurfaceSlots)
+	{
+		OutImportData.MaxMaterialIndex = FMath::Max<uint32>(OutImportData.MaxMaterialIndex, Slot);
+	}
+	OutImportData.Wedges.SetNumZeroed(VertexCount);
+	int32 TriangleCount = 0;
+	int32 InfluenceCount = 0;
+	for (const C2MSurface* Surface : InMesh->Surfaces)
+	{
+		TriangleCount += Surface->Faces.Num();
+		InfluenceCount += Surface->WeightValues.Num();
+		OutImportData.bHasNormals &= Surface->Normals.Num() == Surface->Positions.Num();
+		OutImportData.bHasVertexColors |= Surface->Colors.Num() == Surface->Positions.Num();
+	}
+	OutImportData.Faces.Reset(TriangleCount);
+	OutImportData.Influences.Reset(InfluenceCount);
+
+	// Welded source vertices share identical influences, only the first one of each point adds them
+	int32 NextPoint = 0;
+	int32 FirstVertex = 0;
+	for (int32 SurfaceIndex = 0; SurfaceIndex < InMesh->Surfaces.Num(); SurfaceIndex++)
+	{
+		const C2MSurface* Surface = InMesh->Surfaces[SurfaceIndex];
+		const int32 SurfaceVertexCount = Surface->Positions.Num();
+		const int32 UVCount = Surface->UVs.Num() >= SurfaceVertexCount * Surface->UVCount ? FMath::Min<int32>(Surface->UVCount, OutImportData.NumTexCoords) : 0;
+		const bool bHasColors = Surface->Colors.Num() == SurfaceVertexCount;
+		const int32 SkinStride = FMath::Max<int32>(Surface->MaxSkinBuffer, 1);
+		const bool bHasWeights = Surface->WeightValues.Num() >= SurfaceVertexCount * SkinStride && Surface->WeightBoneIDs.Num() >= SurfaceVertexCount * SkinStride;
+		for (int32 VertexIndex = 0; VertexIndex < SurfaceVertexCount; VertexIndex++)
+		{
+			const int32 SourceIndex = FirstVertex + VertexIndex;
+			const int32 PointIndex = bWelded ? WeldedVertexIDs[SourceIndex] : SourceIndex;
+			SkeletalMeshImportData::FVertex& Wedge = OutImportData.Wedges[SourceIndex];
+			Wedge.VertexIndex = PointIndex;
+			Wedge.MatIndex = SurfaceSlots[SurfaceIndex];
+			Wedge.Color = bHasColors ? Surface->Colors[VertexIndex].ToFColor() : FColor::White;
+			for (int32 Channel = 0; Channel < UVCount; Channel++)
+			{
+				Wedge.UVs[Channel] = Surface->UVs[VertexIndex * Surface->UVCount + Channel];
+			}
+
+			if (PointIndex != NextPoint)
+			{
+				continue;
+			}
+			NextPoint++;
+			if (!bHasWeights)
+			{
+				continue;
+			}
+			for (int32 Slot = VertexIndex * SkinStride; Slot < (VertexIndex + 1) * SkinStride; Slot++)
+			{
+				if (Surface->WeightValues[Slot] > 0)
 				{
-					SkeletalMeshImportData::FRawBoneInfluence Influence;
-					Influence.BoneIndex = weight.WeightID;
-					Influence.VertexIndex = weight.VertexIndex;
-					Influence.Weight = weight.WeightValue;
-					Influences.Add(Influence);
+					SkeletalMeshImportData::FRawBoneInfluence& Influence = OutImportData.Influences.AddDefaulted_GetRef();
+					const uint32_t BoneIndex = Surface->WeightBoneIDs[Slot];
+					Influence.BoneIndex = BoneRemap.Num() == 0 ? BoneIndex : (BoneRemap.IsValidIndex(BoneIndex) ? BoneRemap[BoneIndex] : 0);
+					Influence.VertexIndex = PointIndex;
+					Influence.Weight = Surface->WeightValues[Slot];
 				}
 			}
 		}
+
+		for (const GfxFace& Face : Surface->Faces)
+		{
+			// Faces pointing outside their surface and degenerate faces (where two or more corners share a point) are dropped
+			if (FMath::Min3(Face.index[0], Face.index[1], Face.index[2]) < uint32_t(FirstVertex) ||
+				FMath::Max3(Face.index[0], Face.index[1], Face.index[2]) >= uint32_t(FirstVertex + SurfaceVertexCount))
+			{
+				continue;
+			}
+			const int32 A = OutImportData.Wedges[Face.index[0]].VertexIndex;
+			const int32 B = OutImportData.Wedges[Face.index[1]].VertexIndex;
+			const int32 C = OutImportData.Wedges[Face.index[2]].VertexIndex;
+			if (A == B || B == C || C == A)
+			{
+				continue;
+			}
+			SkeletalMeshImportData::FTriangle& Triangle = OutImportData.Faces.AddZeroed_GetRef();
+			Triangle.MatIndex = SurfaceSlots[SurfaceIndex];
+			Triangle.SmoothingGroups = 255;
+			for (int32 Corner = 0; Corner < 3; Corner++)
+			{
+				const uint32_t SourceIndex = Face.index[Corner];
+				Triangle.WedgeIndex[Corner] = SourceIndex;
+				if (OutImportData.bHasNormals)
+				{
+					Triangle.TangentZ[Corner] = Surface->Normals[SourceIndex - FirstVertex];
+				}
+			}
+		}
+		FirstVertex += SurfaceVertexCount;
 	}
-	SkelMeshImportData.Influences = Influences;
-	SkeletalMesh->SaveLODImportedData(0,SkelMeshImportData);
-	SkeletalMesh->CalculateInvRefMatrices();
-	FSkeletalMeshBuildSettings BuildOptions;
-	BuildOptions.bRemoveDegenerates = true;
-	BuildOptions.bRecomputeTangents = true;
-	BuildOptions.bUseMikkTSpace = true;
-	SkeletalMesh->GetLODInfo(0)->BuildSettings = BuildOptions;
-	SkeletalMesh->SetImportedBounds(FBoxSphereBounds(FBoxSphereBounds3f(FBox3f(SkelMeshImportData.Points))));
+}
 
 
+UObject* C2MStaticMesh::CreateSkeletalMesh(UObject* ParentPackage, const TArray<C2Mesh*>& InLODs, const TArray<C2Material*>& CoDMaterials)
+{
+	const C2Mesh* InMesh = InLODs[0];
+	FString ObjectName = InMesh->Header->MeshName.Replace(TEXT("::"), TEXT("_"));
+	TArray<FMaterialSlot> Slots;
+	TArray<TArray<int32>> SurfaceSlots;
+	ResolveMaterialSlots(InLODs, CoDMaterials, Slots, SurfaceSlots);
+	// Every LOD is skinned against LOD0's bones, their import data is independent until it is saved
+	TArray<FSkeletalMeshImportData> LODImportData;
+	LODImportData.SetNum(InLODs.Num());
+	ParallelFor(InLODs.Num(), [&](int32 LODIndex)
+	{
+		FillSkeletalImportData(InLODs[LODIndex], InMesh, SurfaceSlots[LODIndex], LODImportData[LODIndex]);
+	}, EParallelForFlags::Unbalanced);
+
+	USkeletalMesh* SkeletalMesh = NewObject<USkeletalMesh>(ParentPackage, FName(*ObjectName), RF_Public | RF_Standalone);
+	USkeleton* Skeleton = nullptr;
+	FReferenceSkeleton RefSkel;
+	CreateSkeleton(LODImportData[0], ObjectName, SkeletalMesh->GetPackage(), RefSkel, Skeleton);
+
+	// Faces and wedges of every LOD already point at their material slot
+	for (const FMaterialSlot& Slot : Slots)
+	{
+		UMaterialInterface* Material = CreateSlotMaterial(ParentPackage, Slot, CoDMaterials);
+		SkeletalMesh->GetMaterials().Add(FSkeletalMaterial(Material, true, false, Slot.Name, Slot.Name));
+		for (FSkeletalMeshImportData& ImportData : LODImportData)
+		{
+			SkeletalMeshImportData::FMaterial& ImportMaterial = ImportData.Materials.AddDefaulted_GetRef();
+			ImportMaterial.Material = Material;
+			ImportMaterial.MaterialImportName = Slot.Name.ToString();
+		}
+	}
+
+	SkeletalMesh->PreEditChange(nullptr);
+	SkeletalMesh->SetRefSkeleton(RefSkel);
+	SkeletalMesh->CalculateInvRefMatrices();
+	SkeletalMesh->SetHasVertexColors(LODImportData[0].bHasVertexColors);
+	SkeletalMesh->SetImportedBounds(FBoxSphereBounds(FBoxSphereBounds3f(FBox3f(LODImportData[0].Points))));
+	FSkeletalMeshModel* ImportedModel = SkeletalMesh->GetImportedModel();
+	ImportedModel->LODModels.Empty();
+	SkeletalMesh->ResetLODInfo();
+	for (int32 LODIndex = 0; LODIndex < LODImportData.Num(); LODIndex++)
+	{
+		ImportedModel->LODModels.Add(new FSkeletalMeshLODModel());
+		// Authored LODs, nothing is reduced
+		FSkeletalMeshLODInfo& LODInfo = SkeletalMesh->AddLODInfo();
+		LODInfo.ReductionSettings.NumOfTrianglesPercentage = 1.0f;
+		LODInfo.ReductionSettings.NumOfVertPercentage = 1.0f;
+		LODInfo.ReductionSettings.MaxDeviationPercentage = 0.0f;
+		LODInfo.LODHysteresis = 0.02f;
+		FSkeletalMeshBuildSettings BuildOptions;
+		BuildOptions.bRemoveDegenerates = true;
+		BuildOptions.bRecomputeNormals = !LODImportData[LODIndex].bHasNormals;
+		BuildOptions.bRecomputeTangents = true;
+		BuildOptions.bUseMikkTSpace = true;
+		LODInfo.BuildSettings = BuildOptions;
+		SkeletalMesh->SaveLODImportedData(LODIndex, LODImportData[LODIndex]);
+	}
+
 	auto& MeshBuilderModule = IMeshBuilderModule::GetForRunningPlatform();
-	const FSkeletalMeshBuildParameters SkeletalMeshBuildParameters(SkeletalMesh, GetTargetPlatformManagerRef().GetRunningTargetPlatform(), 0, false);
-	if (!MeshBuilderModule.BuildSkeletalMesh(SkeletalMeshBuildParameters))
+	for (int32 LODIndex = 0; LODIndex < LODImportData.Num(); LODIndex++)
 	{
-		SkeletalMesh->BeginDestroy();
-		return nullptr;
+		const FSkeletalMeshBuildParameters SkeletalMeshBuildParameters(SkeletalMesh, GetTargetPlatformManagerRef().GetRunningTargetPlatform(), LODIndex, false);
+		if (MeshBuilderModule.BuildSkeletalMesh(SkeletalMeshBuildParameters))
+		{
+			continue;
+		}
+		if (LODIndex == 0)
+		{
+			SkeletalMesh->BeginDestroy();
+			return nullptr;
+		}
+		// Keep the LODs that built, a broken lower LOD shouldn't cost the whole mesh
+		UE_LOG(LogTemp, Warning, TEXT("LOD%d of '%s' failed to build and was dropped"), LODIndex, *ObjectName);
+		while (SkeletalMesh->GetLODNum() > LODIndex)
+		{
+			ImportedModel->LODModels.RemoveAt(LODIndex);
+			SkeletalMesh->RemoveLODInfo(LODIndex);
+		}
+		break;
 	}
-	
+	FinalizeSkeletalMesh(SkeletalMesh, Skeleton);
+	return SkeletalMesh;
+}
 
+
+void C2MStaticMesh::FinalizeSkeletalMesh(USkeletalMesh* SkeletalMesh, USkeleton* Skeleton)
+{
 	SkeletalMesh->PostEditChange();
 
 	SkeletalMesh->SetSkeleton(Skeleton);
@@ -121,7 +377,7 @@ UObject* C2MStaticMesh::CreateSkeletalMeshFromStaticMesh(UStaticMesh* Mesh, C2Me
 	// Physics Asset
 	FPhysAssetCreateParams NewBodyData;
 	FString Phy_ObjectName = FString::Printf(TEXT("%s_PhysicsAsset"), *SkeletalMesh->GetName());
-	auto PhysicsPackage = CreatePackage(*FPaths::Combine(FPaths::GetPath(Mesh->GetPackage()->GetPathName()), Phy_ObjectName));
+	auto PhysicsPackage = CreatePackage(*FPaths::Combine(FPaths::GetPath(SkeletalMesh->GetPackage()->GetPathName()), Phy_ObjectName));
 	UPhysicsAsset* PhysicsAsset = NewObject<UPhysicsAsset>(PhysicsPackage, FName(*Phy_ObjectName), RF_Public | RF_Standalone);
 	FText CreationErrorMessage;
 	FPhysicsAssetUtils::CreateFromSkeletalMesh(PhysicsAsset, SkeletalMesh, NewBodyData, CreationErrorMessage);
@@ -132,11 +388,8 @@ UObject* C2MStaticMesh::CreateSkeletalMeshFromStaticMesh(UStaticMesh* Mesh, C2Me
 	PhysicsAsset->MarkPackageDirty();
 	PhysicsAsset->PostEditChange();
 	FAssetRegistryModule::AssetCreated(PhysicsAsset);
-
-	return SkeletalMesh;
-	
 }
-FMeshDescription C2MStaticMesh::CreateMeshDescription(C2Mesh* InMesh)
+FMeshDescription C2MStaticMesh::CreateMeshDescription(const C2Mesh* InMesh)
 {
     // Prepare our base Mesh Description
     FMeshDescription MeshDescription;
@@ -150,148 +403,319 @@ FMeshDescription C2MStaticMesh::CreateMeshDescription(C2Mesh* InMesh)
     const TVertexInstanceAttributesRef<FVector2f> TargetVertexInstanceUVs = CombinedMeshAttributes.GetVertexInstanceUVs();
     const TVertexInstanceAttributesRef<FVector4f> TargetVertexInstanceColors = CombinedMeshAttributes.GetVertexInstanceColors();
 
-    const int32 VertexCount = InMesh->Header->BoneCountBuffer;
+    // Size everything from the real totals, every source vertex becomes one vertex with one vertex instance.
+    // Surfaces share no vertices, so each one owns a disjoint range of vertices and of triangle corners
+    const int32 SurfaceCount = InMesh->Surfaces.Num();
+    TArray<int32> FirstVertices;
+    TArray<int32> FirstTriangles;
+    FirstVertices.SetNumUninitialized(SurfaceCount);
+    FirstTriangles.SetNumUninitialized(SurfaceCount);
+    int32 VertexCount = 0;
+    int32 TriangleCount = 0;
+    for (int32 SurfaceIndex = 0; SurfaceIndex < SurfaceCount; SurfaceIndex++)
+    {
+        FirstVertices[SurfaceIndex] = VertexCount;
+        FirstTriangles[SurfaceIndex] = TriangleCount;
+        VertexCount += InMesh->Surfaces[SurfaceIndex]->Positions.Num();
+        TriangleCount += InMesh->Surfaces[SurfaceIndex]->Faces.Num();
+    }
+    // Optionally share one vertex between source vertices at the same position, instances keep their own attributes
+    TArray<FVector3f> WeldedPositions;
+    TArray<int32> WeldedVertexIDs;
+    int32 UniqueVertexCount = VertexCount;
+    if (MeshOptions && MeshOptions->bWeldVertices)
+    {
+        UniqueVertexCount = WeldVertices(InMesh, MeshOptions->WeldThreshold, false, WeldedVertexIDs, WeldedPositions);
+    }
+    const bool bWelded = WeldedVertexIDs.Num() > 0;
     TargetVertexInstanceUVs.SetNumChannels(InMesh->UVSetCount + 1); // We add 1 slot for Lightmap UV
-    MeshDescription.ReserveNewVertices(InMesh->Header->BoneCountBuffer);
-    MeshDescription.ReserveNewVertexInstances(InMesh->Header->BoneCountBuffer);
-    MeshDescription.ReserveNewPolygons(InMesh->Header->MaterialCountBuffer);
-    MeshDescription.ReserveNewEdges(InMesh->Header->MaterialCountBuffer * 2);
-    TArray<FVertexID> VertexIndexToVertexID;
-    VertexIndexToVertexID.Reserve(VertexCount);
-    TArray<FVertexInstanceID> VertexIndexToVertexInstanceID;
-    VertexIndexToVertexInstanceID.Reserve(VertexCount);
-    int32 GlobalVertexIndex = 0;
-	TArray<FVector3f> Verts;
-
-    // Create vertices and vertex instances
-    for (auto surfirst : InMesh->Surfaces)
+    MeshDescription.ReserveNewVertices(UniqueVertexCount);
+    MeshDescription.ReserveNewVertexInstances(VertexCount);
+    MeshDescription.ReserveNewPolygonGroups(InMesh->Surfaces.Num());
+    MeshDescription.ReserveNewTriangles(TriangleCount);
+    MeshDescription.ReserveNewPolygons(TriangleCount);
+    MeshDescription.ReserveNewEdges(UniqueVertexCount + TriangleCount);
+
+    // A fresh description hands out IDs in order, so source vertex V is vertex instance V (and vertex V unless welded)
+    for (int32 VertexIndex = 0; VertexIndex < UniqueVertexCount; VertexIndex++)
     {
-        for (int i = 0; i < surfirst->Vertexes.Num(); i++)
+        MeshDescription.CreateVertex();
+    }
+    for (int32 VertexIndex = 0; VertexIndex < VertexCount; VertexIndex++)
+    {
+        const FVertexInstanceID VertexInstanceID = MeshDescription.CreateVertexInstance(FVertexID(bWelded ? WeldedVertexIDs[VertexIndex] : VertexIndex));
+        check(VertexInstanceID.GetValue() == VertexIndex);
+    }
+
+    // Fill the attribute arrays straight from the parsed streams, streams missing from the file keep the attribute defaults.
+    // The corners of each triangle are resolved at the same time, degenerate faces are marked so the serial pass skips them
+    const TArrayView<FVector3f> Positions = TargetVertexPositions.GetRawArray();
+    const TArrayView<FVector3f> Normals = TargetVertexInstanceNormals.GetRawArray();
+    const TArrayView<FVector4f> Colors = TargetVertexInstanceColors.GetRawArray();
+    if (bWelded)
+    {
+        FMemory::Memcpy(Positions.GetData(), WeldedPositions.GetData(), UniqueVertexCount * sizeof(FVector3f));
+    }
+    TArray<FVertexInstanceID> Corners;
+    Corners.SetNumUninitialized(TriangleCount * 3);
+    ParallelFor(SurfaceCount, [&](int32 SurfaceIndex)
+    {
+        const C2MSurface* Surface = InMesh->Surfaces[SurfaceIndex];
+        const int32 FirstVertex = FirstVertices[SurfaceIndex];
+        const int32 SurfaceVertexCount = Surface->Positions.Num();
+        if (!bWelded)
         {
-            const FVertexID VertexID = MeshDescription.CreateVertex();
-        	TargetVertexPositions[VertexID] = FVector3f(surfirst->Vertexes[i].Vertice.X, -surfirst->Vertexes[i].Vertice.Y,
-											surfirst->Vertexes[i].Vertice.Z);
-            VertexIndexToVertexID.Add(VertexID);
-        	
-            const FVertexInstanceID VertexInstanceID = MeshDescription.CreateVertexInstance(VertexID);
-            VertexIndexToVertexInstanceID.Add(VertexInstanceID);
-            GlobalVertexIndex++;
-
-        	TargetVertexInstanceNormals[VertexInstanceID] =  FVector3f(surfirst->Vertexes[i].Normal.X, -surfirst->Vertexes[i].Normal.Y,
-											surfirst->Vertexes[i].Normal.Z);
-        	
-            TargetVertexInstanceColors[VertexInstanceID] = surfirst->Vertexes[i].Color.ToVector();
-
-            //TArray<FVector2f> VertexUVs = InMesh->UVs[i];
-            for (int u = 0; u < InMesh->UVSetCount; u++)
+            FMemory::Memcpy(Positions.GetData() + FirstVertex, Surface->Positions.GetData(), SurfaceVertexCount * sizeof(FVector3f));
+        }
+        if (Surface->Normals.Num() == SurfaceVertexCount)
+        {
+            FMemory::Memcpy(Normals.GetData() + FirstVertex, Surface->Normals.GetData(), SurfaceVertexCount * sizeof(FVector3f));
+        }
+        if (Surface->Colors.Num() == SurfaceVertexCount)
+        {
+            for (int32 VertexIndex = 0; VertexIndex < SurfaceVertexCount; VertexIndex++)
             {
-				//TargetVertexInstanceUVs.Set(VertexInstanceID, u, FVector2f(surfirst->Vertexes[i].UV.X, 1 - surfirst->Vertexes[i].UV.Y));
-                TargetVertexInstanceUVs.Set(VertexInstanceID, u, FVector2f(surfirst->Vertexes[i].UV.X, surfirst->Vertexes[i].UV.Y)); // We gotta flip UV
+                Colors[FirstVertex + VertexIndex] = Surface->Colors[VertexIndex].ToVector();
             }
         }
-    }
-
-    // Create polygons and assign polygon group names
-    for (auto Surface : InMesh->Surfaces)
-    {
-        const FPolygonGroupID PolygonGroup = MeshDescription.CreatePolygonGroup();
-
-        for (int f = 0; f < Surface->Faces.Num(); f++)
+        // Source UVs are vertex major, each channel is its own array here
+        const int32 UVCount = Surface->UVs.Num() >= SurfaceVertexCount * Surface->UVCount ? FMath::Min<int32>(Surface->UVCount, InMesh->UVSetCount) : 0;
+        for (int32 Channel = 0; Channel < UVCount; Channel++)
         {
-            auto Face = Surface->Faces[f];
-
-            // Check for degenerate face (where two or more indices are the same)
-            if (Face.index[0] == Face.index[1] ||
-                Face.index[1] == Face.index[2] ||
-                Face.index[2] == Face.index[0])
+            const TArrayView<FVector2f> ChannelUVs = TargetVertexInstanceUVs.GetRawArray(Channel);
+            for (int32 VertexIndex = 0; VertexIndex < SurfaceVertexCount; VertexIndex++)
             {
-                // Skip processing degenerate faces
-                continue;
+                ChannelUVs[FirstVertex + VertexIndex] = Surface->UVs[VertexIndex * Surface->UVCount + Channel];
             }
+        }
 
-            TArray<FVertexInstanceID> VertexInstanceIDs;
-            VertexInstanceIDs.SetNum(3);
-			// Rearrange vertex indices to match Blender order
-
-
-            // Grab Vertex Instances for the current face
-
-        	for (int i = 0; i < 3; i++)
+        FVertexInstanceID* SurfaceCorners = Corners.GetData() + FirstTriangles[SurfaceIndex] * 3;
+        for (const GfxFace& Face : Surface->Faces)
+        {
+            // Faces pointing past the vertices and degenerate faces (where two or more corners share a vertex, welding can make more) are dropped
+            bool bSkip = FMath::Max3(Face.index[0], Face.index[1], Face.index[2]) >= uint32_t(VertexCount);
+            if (!bSkip)
             {
-            	const uint32_t VertexIndex = Face.index[i];
-            	VertexInstanceIDs[i] = VertexIndexToVertexInstanceID[VertexIndex];
-
+                const int32 A = bWelded ? WeldedVertexIDs[Face.index[0]] : Face.index[0];
+                const int32 B = bWelded ? WeldedVertexIDs[Face.index[1]] : Face.index[1];
+                const int32 C = bWelded ? WeldedVertexIDs[Face.index[2]] : Face.index[2];
+                bSkip = A == B || B == C || C == A;
+            }
+            for (int32 Corner = 0; Corner < 3; Corner++)
+            {
+                *SurfaceCorners++ = bSkip ? FVertexInstanceID::Invalid : FVertexInstanceID(Face.index[Corner]);
             }
-
-
-            MeshDescription.CreatePolygon(PolygonGroup, VertexInstanceIDs);
         }
+    }, EParallelForFlags::Unbalanced);
 
-        PolygonGroupNames[PolygonGroup] = FName(Surface->Name);
+    // Triangle creation shares the edge lookup of the whole description, so it stays serial
+    for (int32 SurfaceIndex = 0; SurfaceIndex < SurfaceCount; SurfaceIndex++)
+    {
+        const FPolygonGroupID PolygonGroup = MeshDescription.CreatePolygonGroup();
+        const int32 FirstTriangle = FirstTriangles[SurfaceIndex];
+        const int32 LastTriangle = FirstTriangle + InMesh->Surfaces[SurfaceIndex]->Faces.Num();
+        for (int32 TriangleIndex = FirstTriangle; TriangleIndex < LastTriangle; TriangleIndex++)
+        {
+            const TArrayView<const FVertexInstanceID> TriangleCorners(Corners.GetData() + TriangleIndex * 3, 3);
+            if (TriangleCorners[0] != FVertexInstanceID::Invalid)
+            {
+                MeshDescription.CreateTriangle(PolygonGroup, TriangleCorners);
+            }
+        }
+        PolygonGroupNames[PolygonGroup] = FName(InMesh->Surfaces[SurfaceIndex]->Name);
     }
 
     return MeshDescription;
 }
 
 
-UObject* C2MStaticMesh::CreateStaticMeshFromMeshDescription(UObject* ParentPackage,FMeshDescription& inMeshDescription, C2Mesh* InMesh,  TArray<C2Material*> CoDMaterials)
+/* Skin influences of two vertices match when their non zero slots hold the same bones with the same weights, in order */
+static bool InfluencesMatch(const C2MSurface* SurfaceA, int32 VertexA, const C2MSurface* SurfaceB, int32 VertexB)
+{
+	auto GetSlots = [](const C2MSurface* Surface, int32 Vertex, TArrayView<const uint32_t>& OutBones, TArrayView<const float>& OutWeights)
+	{
+		const int32 SkinStride = FMath::Max<int32>(Surface->MaxSkinBuffer, 1);
+		if (Surface->WeightValues.Num() >= (Vertex + 1) * SkinStride && Surface->WeightBoneIDs.Num() >= (Vertex + 1) * SkinStride)
+		{
+			OutBones = Surface->WeightBoneIDs.Slice(Vertex * SkinStride, SkinStride);
+			OutWeights = Surface->WeightValues.Slice(Vertex * SkinStride, SkinStride);
+		}
+	};
+	TArrayView<const uint32_t> BonesA, BonesB;
+	TArrayView<const float> WeightsA, WeightsB;
+	GetSlots(SurfaceA, VertexA, BonesA, WeightsA);
+	GetSlots(SurfaceB, VertexB, BonesB, WeightsB);
+	int32 SlotA = 0;
+	int32 SlotB = 0;
+	while (true)
+	{
+		while (SlotA < WeightsA.Num() && WeightsA[SlotA] <= 0.0f)
+		{
+			SlotA++;
+		}
+		while (SlotB < WeightsB.Num() && WeightsB[SlotB] <= 0.0f)
+		{
+			SlotB++;
+		}
+		if (SlotA == WeightsA.Num() || SlotB == WeightsB.Num())
+		{
+			return SlotA == WeightsA.Num() && SlotB == WeightsB.Num();
+		}
+		if (BonesA[SlotA] != BonesB[SlotB] || WeightsA[SlotA] != WeightsB[SlotB])
+		{
+			return false;
+		}
+		SlotA++;
+		SlotB++;
+	}
+}
+
+int32 C2MStaticMesh::WeldVertices(const C2Mesh* InMesh, float Threshold, bool bMatchInfluences, TArray<int32>& OutVertexIDs, TArray<FVector3f>& OutPositions)
+{
+	struct FSourceVertex
+	{
+		const C2MSurface* Surface;
+		int32 Index;
+	};
+	TArray<FSourceVertex> SourceVertices;
+	for (const C2MSurface* Surface : InMesh->Surfaces)
+	{
+		for (int32 VertexIndex = 0; VertexIndex < Surface->Positions.Num(); VertexIndex++)
+		{
+			SourceVertices.Add({ Surface, VertexIndex });
+		}
+	}
+
+	// Cells are as wide as the threshold, so any vertex within it is in the same cell or a neighbouring one
+	const float CellSize = FMath::Max(Threshold, UE_KINDA_SMALL_NUMBER);
+	const float ThresholdSquared = FMath::Square(Threshold);
+	// A small threshold on a large mesh gives cell coordinates far past int32, so they are 64-bit and clamped.
+	// Clamped vertices only share a cell, the distance check still keeps them apart
+	auto GetCell = [CellSize](const FVector3f& Position)
+	{
+		constexpr double MaxCell = double(MAX_int64 / 4);
+		auto GetAxis = [CellSize](float Value)
+		{
+			return FMath::FloorToInt64(FMath::Clamp(double(Value) / CellSize, -MaxCell, MaxCell));
+		};
+		return FInt64Vector(GetAxis(Position.X), GetAxis(Position.Y), GetAxis(Position.Z));
+	};
+	// Welded vertices of a cell form a linked list: CellHeads holds the first one, NextInCell the following ones
+	TMap<FInt64Vector, int32> CellHeads;
+	TArray<int32> NextInCell;
+	// Source vertex every welded vertex was created from, its influences are the ones others have to match
+	TArray<int32> Representatives;
+	CellHeads.Reserve(SourceVertices.Num());
+	OutVertexIDs.SetNumUninitialized(SourceVertices.Num());
+	OutPositions.Reset(SourceVertices.Num());
+
+	auto FindMatch = [&](const FSourceVertex& Source, const FVector3f& Position, const FInt64Vector& Cell)
+	{
+		for (int32 Z = -1; Z <= 1; Z++)
+		{
+			for (int32 Y = -1; Y <= 1; Y++)
+			{
+				for (int32 X = -1; X <= 1; X++)
+				{
+					const int32* Head = CellHeads.Find(Cell + FInt64Vector(X, Y, Z));
+					for (int32 Candidate = Head ? *Head : INDEX_NONE; Candidate != INDEX_NONE; Candidate = NextInCell[Candidate])
+					{
+						if (FVector3f::DistSquared(OutPositions[Candidate], Position) > ThresholdSquared)
+						{
+							continue;
+						}
+						const FSourceVertex& Representative = SourceVertices[Representatives[Candidate]];
+						if (!bMatchInfluences || InfluencesMatch(Representative.Surface, Representative.Index, Source.Surface, Source.Index))
+						{
+							return Candidate;
+						}
+					}
+				}
+			}
+		}
+		return int32(INDEX_NONE);
+	};
+
+	for (int32 SourceIndex = 0; SourceIndex < SourceVertices.Num(); SourceIndex++)
+	{
+		const FSourceVertex& Source = SourceVertices[SourceIndex];
+		const FVector3f& Position = Source.Surface->Positions[Source.Index];
+		const FInt64Vector Cell = GetCell(Position);
+		int32 VertexID = FindMatch(Source, Position, Cell);
+		if (VertexID == INDEX_NONE)
+		{
+			VertexID = OutPositions.Add(Position);
+			Representatives.Add(SourceIndex);
+			int32& Head = CellHeads.FindOrAdd(Cell, INDEX_NONE);
+			NextInCell.Add(Head);
+			Head = VertexID;
+		}
+		OutVertexIDs[SourceIndex] = VertexID;
+	}
+	return OutPositions.Num();
+}
+
+UObject* C2MStaticMesh::CreateStaticMeshFromMeshDescriptions(UObject* ParentPackage, TArray<FMeshDescription>& InMeshDescriptions, const TArray<C2Mesh*>& InLODs, const TArray<C2Material*>& CoDMaterials)
 {
+	const C2Mesh* InMesh = InLODs[0];
 	FString ObjectName = InMesh->Header->MeshName.Replace(TEXT("::"), TEXT("_"));
 	UStaticMesh* StaticMesh = NewObject<UStaticMesh>(ParentPackage, FName(*ObjectName), RF_Public | RF_Standalone);
 	// Set default settings
 	StaticMesh->InitResources();
 	StaticMesh->SetLightingGuid();
 	// StaticMesh->bGenerateMeshDistanceField = false;
-	FStaticMeshSourceModel& SrcModel = StaticMesh->AddSourceModel();
-	SrcModel.BuildSettings.bRecomputeNormals = false;
-	SrcModel.BuildSettings.bRecomputeTangents = true;
-	SrcModel.BuildSettings.bRemoveDegenerates = false;
-	SrcModel.BuildSettings.bUseHighPrecisionTangentBasis = false;
-	SrcModel.BuildSettings.bUseFullPrecisionUVs = false;
-	SrcModel.BuildSettings.bGenerateLightmapUVs = true;
-	SrcModel.BuildSettings.SrcLightmapIndex = 0;
-	SrcModel.BuildSettings.DstLightmapIndex = InMesh->UVSetCount; // We use last UV set for lightmap
-	SrcModel.BuildSettings.bUseMikkTSpace = true;
-
-	// Get & Set Mesh Description
-	FMeshDescription* MeshDescription = StaticMesh->GetMeshDescription(0);
-	
-	if (!MeshDescription)
+	TArray<FMaterialSlot> Slots;
+	TArray<TArray<int32>> SurfaceSlots;
+	ResolveMaterialSlots(InLODs, CoDMaterials, Slots, SurfaceSlots);
+	for (int32 LODIndex = 0; LODIndex < InMeshDescriptions.Num(); LODIndex++)
 	{
-		MeshDescription = StaticMesh->CreateMeshDescription(0);
-	}
-	*MeshDescription = inMeshDescription;
-	StaticMesh->CommitMeshDescription(0);
-	TArray<FStaticMaterial> StaticMaterials;
-	// Create materials and mesh sections
-	for (int i = 0; i < InMesh->Surfaces.Num(); i++)
-	{
-		const auto Surface = InMesh->Surfaces[i];
-		
-		// Static Material for Surface
-		FStaticMaterial&& UEMat = FStaticMaterial(UMaterial::GetDefaultMaterial(MD_Surface));
-		if(Surface->Materials.Num() > 0 && MeshOptions->bImportMaterials)
+		const C2Mesh* LODMesh = InLODs[LODIndex];
+		FStaticMeshSourceModel& SrcModel = StaticMesh->AddSourceModel();
+		SrcModel.BuildSettings.bRecomputeNormals = !LODMesh->Header->HasMeshData(C2MeshHeader::SEModelMeshPresenceFlags::SEMODEL_PRESENCE_NORMALS);
+		SrcModel.BuildSettings.bRecomputeTangents = true;
+		SrcModel.BuildSettings.bRemoveDegenerates = false;
+		SrcModel.BuildSettings.bUseHighPrecisionTangentBasis = false;
+		SrcModel.BuildSettings.bUseFullPrecisionUVs = false;
+		SrcModel.BuildSettings.bGenerateLightmapUVs = true;
+		SrcModel.BuildSettings.SrcLightmapIndex = 0;
+		SrcModel.BuildSettings.DstLightmapIndex = LODMesh->UVSetCount; // We use last UV set for lightmap
+		SrcModel.BuildSettings.bUseMikkTSpace = true;
+
+		// Every polygon group is one surface, point it and its section at the surface's material slot
+		FMeshDescription& LODDescription = InMeshDescriptions[LODIndex];
+		const TPolygonGroupAttributesRef<FName> PolygonGroupNames = FStaticMeshAttributes(LODDescription).GetPolygonGroupMaterialSlotNames();
+		for (int32 SurfaceIndex = 0; SurfaceIndex < SurfaceSlots[LODIndex].Num(); SurfaceIndex++)
 		{
-			// Create an array of Surface Materials
-			TArray<C2Material*> SurfMaterials;
-			SurfMaterials.Reserve(Surface->Materials.Num());
-			for (const uint16_t MaterialIndex : Surface->Materials)
-				SurfMaterials.Push(CoDMaterials[MaterialIndex]);
-			UMaterialInterface* MaterialInstance = C2MMaterialInstance::CreateMixMaterialInstance( SurfMaterials,ParentPackage,MeshOptions->OverrideMasterMaterial.LoadSynchronous());
-			UEMat = FStaticMaterial(MaterialInstance);
+			const int32 Slot = SurfaceSlots[LODIndex][SurfaceIndex];
+			PolygonGroupNames[FPolygonGroupID(SurfaceIndex)] = Slots[Slot].Name;
+			StaticMesh->GetSectionInfoMap().Set(LODIndex, SurfaceIndex, FMeshSectionInfo(Slot));
 		}
+
+		// Get & Set Mesh Description
+		FMeshDescription* MeshDescription = StaticMesh->GetMeshDescription(LODIndex);
+		if (!MeshDescription)
+		{
+			MeshDescription = StaticMesh->CreateMeshDescription(LODIndex);
+		}
+		*MeshDescription = MoveTemp(LODDescription);
+		StaticMesh->CommitMeshDescription(LODIndex);
+	}
+	TArray<FStaticMaterial> StaticMaterials;
+	// Create materials, one per slot
+	for (const FMaterialSlot& Slot : Slots)
+	{
+		FStaticMaterial UEMat = FStaticMaterial(CreateSlotMaterial(ParentPackage, Slot, CoDMaterials));
 		UEMat.UVChannelData.bInitialized = true;
-		UEMat.MaterialSlotName = FName(Surface->Name);
-		UEMat.ImportedMaterialSlotName = FName(Surface->Name);
+		UEMat.MaterialSlotName = Slot.Name;
+		UEMat.ImportedMaterialSlotName = Slot.Name;
 		StaticMaterials.Add(UEMat);
-		StaticMesh->GetSectionInfoMap().Set(0, i, FMeshSectionInfo(i));
 	}
 	StaticMesh->SetStaticMaterials(StaticMaterials);
 	StaticMesh->GetOriginalSectionInfoMap().CopyFrom(StaticMesh->GetSectionInfoMap());
 	StaticMesh->ImportVersion = EImportStaticMeshVersion::LastVersion;
 	// Editor builds cache the mesh description so that it can be preserved during map reloads etc
 	TArray<FText> BuildErrors;
-	// Build mesh from source
+	// Build every LOD from source in one go
 	StaticMesh->Build(false);
 	StaticMesh->EnforceLightmapRestrictions();
 	// StaticMesh->PostEditChange();
@@ -344,24 +768,32 @@ void C2MStaticMesh::ProcessSkeleton(const FSkeletalMeshImportData& ImportData, c
 }
 
 
-void C2MStaticMesh::CreateSkeleton(C2Mesh* InMesh, FString ObjectName, UPackage* ParentPackage, FReferenceSkeleton& OutRefSkeleton, USkeleton*& OutSkeleton)
+void C2MStaticMesh::FillBoneImportData(const C2Mesh* InMesh, FSkeletalMeshImportData& OutImportData)
 {
-	FSkeletalMeshImportData SkelMeshImportData;
-	
-	for (auto PskBone : InMesh->Bones)
+	// Convert every bone rotation to Unreal's axes in one pass
+	TArray<FQuat4f> LocalRotations;
+	LocalRotations.Reserve(InMesh->Bones.Num());
+	for (const C2Bone& PskBone : InMesh->Bones)
+	{
+		LocalRotations.Add(PskBone.LocalRotation);
+	}
+	C2MUtilsImport::FlipRotationsY(LocalRotations);
+
+	for (int32 BoneIndex = 0; BoneIndex < InMesh->Bones.Num(); BoneIndex++)
 	{
+		const C2Bone& PskBone = InMesh->Bones[BoneIndex];
 		SkeletalMeshImportData::FBone Bone;
 		Bone.Name = PskBone.Name;
 		Bone.ParentIndex = PskBone.ParentIndex == -1 ? INDEX_NONE : PskBone.ParentIndex;
 		FVector3f PskBonePos = PskBone.LocalPosition;
-		auto PskBoneRotEu = PskBone.LocalRotation;
-		PskBoneRotEu.Yaw *= -1.0;
-		PskBoneRotEu.Roll *= -1.0;
+		FQuat4f PskBoneRot = LocalRotations[BoneIndex];
 		if (Bone.Name == "j_mainroot")
 		{
+			// The roll override is an euler angle, only this bone goes through the rotator
+			FRotator3f PskBoneRotEu = PskBoneRot.Rotator();
 			PskBoneRotEu.Roll = MeshOptions->OverrideSkeletonRootRoll;
+			PskBoneRot = PskBoneRotEu.Quaternion();
 		}
-		FQuat4f PskBoneRot = PskBoneRotEu.Quaternion();
 		FTransform3f PskTransform;
 
 		PskTransform.SetLocation(FVector4f(PskBonePos.X,-PskBonePos.Y,PskBonePos.Z));
@@ -369,8 +801,13 @@ void C2MStaticMesh::CreateSkeleton(C2Mesh* InMesh, FString ObjectName, UPackage*
 		SkeletalMeshImportData::FJointPos BonePos;
 		BonePos.Transform = PskTransform;
 		Bone.BonePos = BonePos;
-		SkelMeshImportData.RefBonesBinary.Add(Bone);
+		OutImportData.RefBonesBinary.Add(Bone);
 	}
+}
+
+
+void C2MStaticMesh::CreateSkeleton(const FSkeletalMeshImportData& SkelMeshImportData, FString ObjectName, UPackage* ParentPackage, FReferenceSkeleton& OutRefSkeleton, USkeleton*& OutSkeleton)
+{
 	auto newName = "SK_" + ObjectName;
 	auto SkeletonPackage = CreatePackage(*FPaths::Combine(FPaths::GetPath(ParentPackage->GetPathName()), newName));
 	OutSkeleton = MeshOptions->OverrideSkeleton.IsValid() ? MeshOptions->OverrideSkeleton.LoadSynchronous() : NewObject<USkeleton>(SkeletonPackage, FName(*newName), RF_Public | RF_Standalone);
@@ -10,14 +10,34 @@
 class C2MStaticMesh
 {
 public:
+	// A material slot of the built mesh and the LOD0 materials (indices into CoDMaterials) it mixes
+	struct FMaterialSlot
+	{
+		FName Name;
+		TArray<int32> MaterialIndices;
+	};
+
 	UUserMeshOptions* MeshOptions;
-	UObject* CreateMesh(UObject* ParentPackage,FString ModelPackage, C2Mesh* InMesh,  const TArray<C2Material*>& CoDMaterials);
-	FMeshDescription CreateMeshDescription(C2Mesh* InMesh);
-	UObject* CreateStaticMeshFromMeshDescription(UObject* ParentPackage,FMeshDescription& inMeshDescription, C2Mesh* InMesh,  TArray<C2Material*> CoDMaterials);
+	/* Builds every LOD into one static or skeletal mesh, InLODs[0] is the base mesh */
+	UObject* CreateMesh(UObject* ParentPackage,FString ModelPackage, const TArray<C2Mesh*>& InLODs,  const TArray<C2Material*>& CoDMaterials);
+	FMeshDescription CreateMeshDescription(const C2Mesh* InMesh);
+	/* LOD0 surfaces get a slot each, lower LOD surfaces share the slot of a LOD0 surface mixing the same materials
+	 * (matched by name against CoDMaterials) or get a slot of their own. OutSurfaceSlots holds the slot of every surface of every LOD */
+	static void ResolveMaterialSlots(const TArray<C2Mesh*>& InLODs, const TArray<C2Material*>& CoDMaterials, TArray<FMaterialSlot>& OutSlots, TArray<TArray<int32>>& OutSurfaceSlots);
+	/* Hash-grid weld of every surface's vertices, in surface order. Fills the vertex each source vertex maps to and the
+	 * position of every welded vertex, returns the welded vertex count */
+	static int32 WeldVertices(const C2Mesh* InMesh, float Threshold, bool bMatchInfluences, TArray<int32>& OutVertexIDs, TArray<FVector3f>& OutPositions);
+	UObject* CreateStaticMeshFromMeshDescriptions(UObject* ParentPackage, TArray<FMeshDescription>& InMeshDescriptions, const TArray<C2Mesh*>& InLODs, const TArray<C2Material*>& CoDMaterials);
 	void ProcessSkeleton(const FSkeletalMeshImportData& ImportData, const USkeleton* Skeleton, FReferenceSkeleton& OutRefSkeleton, int& OutSkeletalDepth);
-	UObject* CreateSkeletalMeshFromMeshDescription( UObject* ParentPackage,FMeshDescription& InMeshDescription, C2Mesh* InMesh,  TArray<C2Material*> CoDMaterials);
-	void CreateSkeleton(C2Mesh* InMesh, FString ObjectName, UPackage* ParentPackage, FReferenceSkeleton& OutRefSkeleton, USkeleton*& OutSkeleton);
-
-	UObject* CreateSkeletalMeshFromStaticMesh(UStaticMesh* Mesh, C2Mesh* InMesh);
+	void CreateSkeleton(const FSkeletalMeshImportData& SkelMeshImportData, FString ObjectName, UPackage* ParentPackage, FReferenceSkeleton& OutRefSkeleton, USkeleton*& OutSkeleton);
+	void FillBoneImportData(const C2Mesh* InMesh, FSkeletalMeshImportData& OutImportData);
+	/* Points, wedges, faces, influences and bones straight from the parsed surfaces, welded when the options ask for it.
+	 * Bones come from BaseMesh, influences of a lower LOD are moved onto them by name */
+	void FillSkeletalImportData(const C2Mesh* InMesh, const C2Mesh* BaseMesh, TArrayView<const int32> SurfaceSlots, FSkeletalMeshImportData& OutImportData);
+	// Builds the skeletal mesh once from the import data, without going through a static mesh
+	UObject* CreateSkeletalMesh(UObject* ParentPackage, const TArray<C2Mesh*>& InLODs, const TArray<C2Material*>& CoDMaterials);
+	// Skeleton merge, asset registration and physics asset, once the skeletal mesh is built
+	void FinalizeSkeletalMesh(USkeletalMesh* SkeletalMesh, USkeleton* Skeleton);
+	UMaterialInterface* CreateSlotMaterial(UObject* ParentPackage, const FMaterialSlot& Slot, const TArray<C2Material*>& CoDMaterials);
 };
 
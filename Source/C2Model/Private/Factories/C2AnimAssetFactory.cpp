@@ -3,7 +3,8 @@
 #include "Structures/C2Anim.h"
 #include "ToolMenus.h"
 #include "Engine.h"
-#include "Misc/FileHelper.h"
+#include "Utils/C2MReader.h"
+#include "Utils/C2MParseCache.h"
 #include "Animation/AnimData/IAnimationDataController.h"
 #include "AssetToolsModule.h"
 #include "ComponentReregisterContext.h"
@@ -16,6 +17,10 @@
 #include "Commandlets/ImportAssetsCommandlet.h"
 #include "FileHelpers.h"
 #include "AnimationBlueprintLibrary.h"
+#include "Misc/ScopeExit.h"
+#include "Utils/C2MTrackResampler.h"
+#include "Utils/C2MUtilsImport.h"
+#include "Async/ParallelFor.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(C2AnimAssetFactory)
 #define LOCTEXT_NAMESPACE "C2AnimAssetFactory"
@@ -35,6 +40,64 @@ UC2AnimAssetFactory::UC2AnimAssetFactory( const FObjectInitializer& ObjectInitia
 }
 
 
+/**
+ * Bake one bone into dense per-frame tracks, converted to Unreal's axes and offset by the pose for non absolute anims.
+ * In curve mode (bBakeTransforms off) positions and rotations live in the curves and the track only carries scale,
+ * padded with the pose like before. All three tracks are padded to the longest one.
+ */
+static void BakeBoneTrack(const BoneInfo& KeyFrameBone, const FTransform& BonePoseTransform, ESEAnimAnimationType AnimType, bool bBakeTransforms, FC2Anims& OutTrack)
+{
+    const bool bAbsolute = AnimType == ESEAnimAnimationType::SEANIM_ABSOLUTE;
+    OutTrack.Name = KeyFrameBone.Name;
+    OutTrack.PosKeys.Reset();
+    OutTrack.RotKeys.Reset();
+    OutTrack.ScaleKeys.Reset();
+
+    const C2AnimTrack<FVector3f>& Positions = KeyFrameBone.BonePositions;
+    if (bBakeTransforms && Positions.Num() > 0)
+    {
+        // The offset is 0 for absolute anims, it's needed for relative/delta/additive
+        const FVector3f RelativeOffset = bAbsolute ? FVector3f::ZeroVector : FVector3f(BonePoseTransform.GetLocation());
+        TArray<FVector3f> Keys;
+        Keys.SetNumUninitialized(Positions.Num());
+        for (int32 i = 0; i < Positions.Num(); i++)
+        {
+            const FVector3f& Value = Positions.Values[i];
+            Keys[i] = FVector3f(Value.X, -Value.Y, Value.Z) + RelativeOffset;
+        }
+        OutTrack.PosKeys.SetNumUninitialized(C2MTrackResampler::GetDenseLength(Positions.Frames));
+        C2MTrackResampler::ResampleVectors(Positions.Frames, Keys, OutTrack.PosKeys);
+    }
+
+    const C2AnimTrack<FQuat4f>& Rotations = KeyFrameBone.BoneRotations;
+    if (bBakeTransforms && Rotations.Num() > 0)
+    {
+        const FQuat4f RelativeRotation = AnimType == ESEAnimAnimationType::SEANIM_ADDITIVE ? FQuat4f(BonePoseTransform.GetRotation()) : FQuat4f::Identity;
+        TArray<FQuat4f> Keys;
+        Keys.SetNumUninitialized(Rotations.Num());
+        for (int32 i = 0; i < Rotations.Num(); i++)
+        {
+            Keys[i] = Rotations.Values[i] * RelativeRotation;
+        }
+        // Unreal uses other axis type than COD engine
+        C2MUtilsImport::FlipRotationsY(Keys);
+        OutTrack.RotKeys.SetNumUninitialized(C2MTrackResampler::GetDenseLength(Rotations.Frames));
+        C2MTrackResampler::ResampleRotations(Rotations.Frames, Keys, OutTrack.RotKeys);
+    }
+
+    const C2AnimTrack<FVector3f>& Scales = KeyFrameBone.BoneScale;
+    if (Scales.Num() > 0)
+    {
+        OutTrack.ScaleKeys.SetNumUninitialized(C2MTrackResampler::GetDenseLength(Scales.Frames));
+        C2MTrackResampler::ResampleVectors(Scales.Frames, Scales.Values, OutTrack.ScaleKeys);
+    }
+
+    const int32 ArrLen = FMath::Max3(OutTrack.PosKeys.Num(), OutTrack.RotKeys.Num(), OutTrack.ScaleKeys.Num());
+    C2MTrackResampler::PadTrack(OutTrack.PosKeys, ArrLen, bAbsolute ? FVector3f::ZeroVector : FVector3f(BonePoseTransform.GetLocation()));
+    C2MTrackResampler::PadTrack(OutTrack.RotKeys, ArrLen, FQuat4f(BonePoseTransform.GetRotation()));
+    C2MTrackResampler::PadTrack(OutTrack.ScaleKeys, ArrLen, FVector3f::OneVector);
+}
+
 /* UFactory overrides
  *****************************************************************************/
 
@@ -49,6 +112,8 @@ UObject* UC2AnimAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPare
         SlowTask.MakeDialog(true);
     }
     SlowTask.EnterProgressFrame(0);
+    C2MFileReader Reader;
+    const bool bOpened = Reader.Open(Filename);
 
     // picker
     if (SettingsImporter->bInitialized == false)
@@ -70,6 +135,14 @@ UObject* UC2AnimAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPare
             .WidgetWindow(Window)
         );
         SettingsImporter = ImportOptionsWindow.Get()->Stun;
+        // The dialog only needs the header, the keyframes are parsed once the user confirms
+        C2AnimProbe Probe;
+        if (bOpened && C2Anim::Probe(Reader, Probe))
+        {
+            SettingsImporter->AnimType = Probe.Header.AnimType;
+            SettingsImporter->EndFrame = FMath::Clamp<int64>(static_cast<int64>(Probe.Header.FrameCountBuffer) - 1, 0, MAX_int32);
+        }
+        Reader.Seek(0);
         FSlateApplication::Get().AddModalWindow(Window, ParentWindow, false);
         bImport = ImportOptionsWindow.Get()->ShouldImport();
         bImportAll = ImportOptionsWindow.Get()->ShouldImportAll();
@@ -91,18 +164,31 @@ UObject* UC2AnimAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPare
     AnimSequence->ResetAnimation();
     Bones = Skeleton->GetReferenceSkeleton().GetRawRefBoneInfo();
     BonePoses = Skeleton->GetReferenceSkeleton().GetRawRefBonePose();
-    TArray64<uint8> FileDataOld;
+    CacheBoneIndices(Skeleton);
 
 	
-    if (FFileHelper::LoadFileToArray(FileDataOld, *Filename))
+    if (bOpened)
     {
-        FLargeMemoryReader Reader(FileDataOld.GetData(), FileDataOld.Num());
-        C2Anim* Anim = new C2Anim();
-        Anim->ParseAnim(Reader);
+        ON_SCOPE_EXIT
+        {
+            ParseArena.LogUsage(FPaths::GetCleanFilename(Filename));
+            ParseArena.Reset();
+        };
+        C2Anim* Anim = ParseArena.New<C2Anim>();
+        if (SettingsImporter->bImportFrameRange)
+        {
+            Anim->SetFrameRange(FMath::Max(SettingsImporter->StartFrame, 0), FMath::Max(SettingsImporter->EndFrame, 0));
+        }
+        C2MParseCache::ParseAnim(Reader, *Anim, ParseArena);
         if (SettingsImporter->bOverrideAnimType)
         {
             Anim->Header.AnimType = SettingsImporter->AnimType;
         }
+        // Bone tracks hold one key per frame, reduced keys would only be resampled back to that, so only curves get them
+        if (SettingsImporter->bReduceKeys && SettingsImporter->bUseCurveeSave)
+        {
+            Anim->ReduceKeys(SettingsImporter->PositionTolerance, SettingsImporter->RotationTolerance, SettingsImporter->ScaleTolerance);
+        }
         Controller.SetFrameRate(FFrameRate(Anim->Header.FrameRate, 1),bShouldTransact);
         Controller.SetNumberOfFrames(FFrameNumber(int(Anim->Header.FrameCountBuffer)), bShouldTransact);
         UE_LOG(LogTemp, Warning, TEXT("This animation '%s' is of type %s"), *Filename, *UEnum::GetValueAsString(Anim->Header.AnimType));
@@ -110,23 +196,36 @@ UObject* UC2AnimAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPare
 
 	    
         bool UseCurveSave=SettingsImporter->bUseCurveeSave;
-        for (int32 BoneTreeIndex = 0; BoneTreeIndex < Bones.Num(); BoneTreeIndex++)
+        // The override pose is evaluated once here instead of once per bone in the loops below
+        const bool bHasRefposeOverride = SettingsImporter->RefposeSequence != nullptr;
+        const bool bRefposeMatchesSkeleton = bHasRefposeOverride && SettingsImporter->RefposeSequence->GetSkeleton() == SettingsImporter->Skeleton;
+        const TArray<FTransform>& RefposeOverride = bHasRefposeOverride ? GetRefposeOverride(Skeleton) : BonePoses;
+
+        TArray<int32> SkeletonBoneIndices;
+        TBitArray<> UnmatchedBones;
+        ResolveAnimBones(*Anim, SkeletonBoneIndices, UnmatchedBones);
+        // Skeleton bones that get a bone track from the animation below, their refpose keys would only be overwritten
+        TBitArray<> AnimatedSkeletonBones(false, Bones.Num());
+        for (int32 BoneIndex = 0; BoneIndex < Anim->BonesInfos.Num(); BoneIndex++)
         {
-            const FName BoneTreeName = Skeleton->GetReferenceSkeleton().GetBoneName(BoneTreeIndex); 
+            if (SkeletonBoneIndices[BoneIndex] != INDEX_NONE && Anim->BonesInfos[BoneIndex].BoneRotations.Num() > 0)
+            {
+                AnimatedSkeletonBones[SkeletonBoneIndices[BoneIndex]] = true;
+            }
+        }
+        const bool bBakesRefpose = !(Anim->Header.AnimType == ESEAnimAnimationType::SEANIM_ABSOLUTE) && !UseCurveSave;
+        const EUnanimatedBoneMode UnanimatedBoneMode = SettingsImporter->UnanimatedBoneMode;
 
-           FTransform RePoseTransform;                                                                              
-           if(SettingsImporter->RefposeSequence&&SettingsImporter->RefposeSequence->GetSkeleton()==SettingsImporter->Skeleton)  
-           {
-               FAnimPoseEvaluationOptions EvaluationOptions;
-               FAnimPose Pose;
-               FName BoneName=BoneTreeName;
-               UAnimPoseExtensions::GetAnimPoseAtFrame( SettingsImporter->RefposeSequence, SettingsImporter->PoseTime,EvaluationOptions,Pose);
-               RePoseTransform =UAnimPoseExtensions::GetBonePose(Pose,BoneName,EAnimPoseSpaces::Local);
-           }
-            else
+        for (int32 BoneTreeIndex = 0; BoneTreeIndex < Bones.Num(); BoneTreeIndex++)
+        {
+            const bool bAnimated = AnimatedSkeletonBones[BoneTreeIndex];
+            if (bBakesRefpose && !bAnimated && UnanimatedBoneMode == EUnanimatedBoneMode::Skip)
             {
-                RePoseTransform=BonePoses[BoneTreeIndex];
+                continue;
             }
+            const FName BoneTreeName = Skeleton->GetReferenceSkeleton().GetBoneName(BoneTreeIndex); 
+
+            const FTransform& RePoseTransform = bRefposeMatchesSkeleton ? RefposeOverride[BoneTreeIndex] : BonePoses[BoneTreeIndex];
 
 
             Controller.AddBoneCurve(BoneTreeName, bShouldTransact);
@@ -137,57 +236,48 @@ UObject* UC2AnimAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPare
                 if (!(Anim->Header.AnimType == ESEAnimAnimationType::SEANIM_ABSOLUTE ))
                     AnimSequence->GetController().SetTransformCurveKey(TransformCurveId,0,RePoseTransform);
             }
-            if(!(Anim->Header.AnimType == ESEAnimAnimationType::SEANIM_ABSOLUTE )&&!UseCurveSave)
+            if (bBakesRefpose && !bAnimated)
             {
-
+                const int32 NumKeys = UnanimatedBoneMode == EUnanimatedBoneMode::ConstantKey ? 1 : AnimSequence->GetNumberOfSampledKeys() + 1;
                 TArray<FVector3f> PositionalKeys;
                 TArray<FQuat4f> RotationalKeys;
                 TArray<FVector3f> ScalingKeys;
-                int32 longer=AnimSequence->GetNumberOfSampledKeys();
-                for(int i=0;i<=longer;i++)
-                {
-                    PositionalKeys.Add(FVector3f(RePoseTransform.GetLocation()));
-                    RotationalKeys.Add(FQuat4f(RePoseTransform.GetRotation()));
-                    ScalingKeys.Add(FVector3f(1,1,1));
-
-                }
+                PositionalKeys.Init(FVector3f(RePoseTransform.GetLocation()), NumKeys);
+                RotationalKeys.Init(FQuat4f(RePoseTransform.GetRotation()), NumKeys);
+                ScalingKeys.Init(FVector3f::OneVector, NumKeys);
                 Controller.SetBoneTrackKeys(BoneTreeName, PositionalKeys, RotationalKeys, ScalingKeys);
-               
             }
         }
 
-        
+
+        // Dense tracks are baked into buffers kept on the factory, so a batch reuses their allocations.
+        // Bones don't depend on each other, bake them all at once and leave only the controller calls to the game thread
+        TracksAll.SetNum(Anim->BonesInfos.Num());
+        ParallelFor(Anim->BonesInfos.Num(), [&](int32 BoneIndex)
+        {
+            const BoneInfo& KeyFrameBone = Anim->BonesInfos[BoneIndex];
+            const int32 SkeletonBoneIndex = SkeletonBoneIndices[BoneIndex];
+            // Only bones with rotation keys get a bone track
+            if (SkeletonBoneIndex != INDEX_NONE && KeyFrameBone.BoneRotations.Num() > 0)
+            {
+                BakeBoneTrack(KeyFrameBone, RefposeOverride[SkeletonBoneIndex], Anim->Header.AnimType, !UseCurveSave, TracksAll[BoneIndex]);
+            }
+        }, EParallelForFlags::Unbalanced);
        
         for (int32 BoneIndex = 0; BoneIndex < Anim->BonesInfos.Num(); BoneIndex++)
         {
             const BoneInfo& KeyFrameBone = Anim->BonesInfos[BoneIndex];   
-            auto BoneMesh = GetBone(KeyFrameBone.Name);
-            if (BoneMesh.Name == "None") { continue; }
+            const int32 SkeletonBoneIndex = SkeletonBoneIndices[BoneIndex];
+            if (SkeletonBoneIndex == INDEX_NONE) { continue; }
             
             // Add Bone Transform curve, and add base pose transform to start
 
          
             FName NewCurveName(KeyFrameBone.Name);
-            TArray<FVector3f> PositionalKeys;
-            TArray<FQuat4f> RotationalKeys;
-            TArray<FVector3f> ScalingKeys;
-            uint32 CurrentFrame = 0;
 
            
             
-          FTransform BonePoseTransform;
-            if(SettingsImporter->RefposeSequence)
-            {
-                FAnimPoseEvaluationOptions EvaluationOptions;
-                FAnimPose Pose;
-                FName BoneName=FName(KeyFrameBone.Name);
-                UAnimPoseExtensions::GetAnimPoseAtFrame( SettingsImporter->RefposeSequence, SettingsImporter->PoseTime,EvaluationOptions,Pose);
-                BonePoseTransform =UAnimPoseExtensions::GetBonePose(Pose,BoneName,EAnimPoseSpaces::Local);
-            }
-            else
-            {
-                BonePoseTransform = BonePoses[GetBoneIndex(KeyFrameBone.Name)]; 
-            }
+            const FTransform& BonePoseTransform = RefposeOverride[SkeletonBoneIndex];
             
             
             /*                        UE4                                     */
@@ -201,10 +291,10 @@ UObject* UC2AnimAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPare
             /*                      ***  UE5 ***                                                        *///
         
 
-            FAnimationCurveIdentifier TransformCurveId(FName(KeyFrameBone.Name), ERawCurveTrackTypes::RCT_Transform);  
+            FAnimationCurveIdentifier TransformCurveId(KeyFrameBone.Name, ERawCurveTrackTypes::RCT_Transform);  
             if(UseCurveSave)
             {
-                Skeleton->AddCurveMetaData(FName(KeyFrameBone.Name));
+                Skeleton->AddCurveMetaData(KeyFrameBone.Name);
                 AnimSequence->GetController().AddCurve(TransformCurveId, AACF_DriveTrack | AACF_Editable);
             }
                
@@ -215,8 +305,8 @@ UObject* UC2AnimAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPare
         // Abandoned, unable to restore complete proposal! Function to be placed above...
           // AnimSequence->GetController().SetTransformCurveKey(TransformCurveId,0,BonePoseTransform); 
             
-            // Loop thru actual bone positions   
-            if (KeyFrameBone.BonePositions.Num() > 0)
+            // Curve mode keeps the sparse keys as rich curves
+            if (UseCurveSave && KeyFrameBone.BonePositions.Num() > 0)
             {
                 TArray<TArray<FRichCurveKey>> PosCurveKeys;
                 TArray<FRichCurveKey> PositionKeysZ;
@@ -234,89 +324,41 @@ UObject* UC2AnimAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPare
                     relative_transform = BonePoseTransform.GetLocation(); ///????
                 }
 
-                if(UseCurveSave)
+                for (size_t i = 0; i < KeyFrameBone.BonePositions.Num(); i++)  
                 {
-                    for (size_t i = 0; i < KeyFrameBone.BonePositions.Num(); i++)  
-                    {
-                        FVector boneFrameVector;
-                        auto BonePosAnimFrame = KeyFrameBone.BonePositions[i];    
-                        BonePosAnimFrame.Value[1] *= -1;
-                        auto TimeInSeconds = static_cast<float>(BonePosAnimFrame.Frame) / Anim->Header.FrameRate;
-                    
-                        // Relative_transform should be 0.0.0 if absolute anim.. its needed for relative/delta/additive  
-                        boneFrameVector.X = BonePosAnimFrame.Value[0] + relative_transform[0];
-                        boneFrameVector.Y = BonePosAnimFrame.Value[1] + relative_transform[1];
-                        boneFrameVector.Z = BonePosAnimFrame.Value[2] + relative_transform[2];
-
-                  
-                    
-                        PositionKeysX.Add(FRichCurveKey(TimeInSeconds, boneFrameVector.X));
-                        PositionKeysY.Add(FRichCurveKey(TimeInSeconds, boneFrameVector.Y));
-                        PositionKeysZ.Add(FRichCurveKey(TimeInSeconds, boneFrameVector.Z));
-                    
-                    }
-                    PosCurveKeys.Add(PositionKeysX);
-                    PosCurveKeys.Add(PositionKeysY);
-                    PosCurveKeys.Add(PositionKeysZ);
+                    FVector boneFrameVector;
+                    auto BonePosAnimFrame = KeyFrameBone.BonePositions[i];    
+                    BonePosAnimFrame.Value[1] *= -1;
+                    auto TimeInSeconds = static_cast<float>(BonePosAnimFrame.Frame) / Anim->Header.FrameRate;
                 
-                    for (int i = 0; i < 3; ++i)
-                    {
-                        const EVectorCurveChannel Axis = static_cast<EVectorCurveChannel>(i);
-                        UAnimationCurveIdentifierExtensions::GetTransformChildCurveIdentifier(TransformCurveId, ETransformCurveChannel::Position, Axis);
-                        AnimSequence->GetController().SetCurveKeys(TransformCurveId, PosCurveKeys[i], bShouldTransact);
-                    }
+                    // Relative_transform should be 0.0.0 if absolute anim.. its needed for relative/delta/additive  
+                    boneFrameVector.X = BonePosAnimFrame.Value[0] + relative_transform[0];
+                    boneFrameVector.Y = BonePosAnimFrame.Value[1] + relative_transform[1];
+                    boneFrameVector.Z = BonePosAnimFrame.Value[2] + relative_transform[2];
+
+                    PositionKeysX.Add(FRichCurveKey(TimeInSeconds, boneFrameVector.X));
+                    PositionKeysY.Add(FRichCurveKey(TimeInSeconds, boneFrameVector.Y));
+                    PositionKeysZ.Add(FRichCurveKey(TimeInSeconds, boneFrameVector.Z));
                 }
-                else
+                PosCurveKeys.Add(PositionKeysX);
+                PosCurveKeys.Add(PositionKeysY);
+                PosCurveKeys.Add(PositionKeysZ);
+            
+                for (int i = 0; i < 3; ++i)
                 {
-                    CurrentFrame = 0;
-                    for (int32 i = 0; i < KeyFrameBone.BonePositions.Num(); ++i,  ++CurrentFrame)  
-                    {
-                        FVector3f boneFrameVector,LastBoneFrameVector;
-                        auto BonePosAnimFrame = KeyFrameBone.BonePositions[i];  
-                        BonePosAnimFrame.Value[1] *= -1;
-                    
-                       
-                        boneFrameVector.X = BonePosAnimFrame.Value[0] + relative_transform[0];//
-                        boneFrameVector.Y = BonePosAnimFrame.Value[1] + relative_transform[1];
-                        boneFrameVector.Z = BonePosAnimFrame.Value[2] + relative_transform[2];
-                    
-                        // 手动插值
-                        if (i == 0 && BonePosAnimFrame.Frame > 0)
-                        {
-                           //开始设置下一针
-                            while (CurrentFrame < BonePosAnimFrame.Frame)
-                            {
-                                PositionalKeys.Add(boneFrameVector);
-                                ++CurrentFrame;
-                            }
-                        }
-                        else
-                        {
-                            while (CurrentFrame < BonePosAnimFrame.Frame) 
-                            {
-                                WraithAnimFrame<FVector3f> LastBonePosAnimFrame = KeyFrameBone.BonePositions[i - 1];
-                                PositionalKeys.Add(
-                                    FMath::Lerp(LastBoneFrameVector,  boneFrameVector,
-                                                static_cast<float>(CurrentFrame - LastBonePosAnimFrame.Frame) /
-                                                static_cast<float>(BonePosAnimFrame.Frame - LastBonePosAnimFrame.Frame)));
-                                ++CurrentFrame;
-                            }
-                        }
-                        LastBoneFrameVector=boneFrameVector; 
-                        PositionalKeys.Add(FVector3f(boneFrameVector));
-                    }
+                    const EVectorCurveChannel Axis = static_cast<EVectorCurveChannel>(i);
+                    UAnimationCurveIdentifierExtensions::GetTransformChildCurveIdentifier(TransformCurveId, ETransformCurveChannel::Position, Axis);
+                    AnimSequence->GetController().SetCurveKeys(TransformCurveId, PosCurveKeys[i], bShouldTransact);
                 }
             }
                 
-          
-            if (KeyFrameBone.BoneRotations.Num() > 0)
+            if (UseCurveSave && KeyFrameBone.BoneRotations.Num() > 0)
             {
                 TArray<TArray<FRichCurveKey>> RotCurveKeys;
                 TArray<FRichCurveKey> RotationKeysZ;
                 TArray<FRichCurveKey> RotationKeysY;
                 TArray<FRichCurveKey> RotationKeysX;
 
-                
                 FQuat Rel_Rotation;
                 if (Anim->Header.AnimType == ESEAnimAnimationType::SEANIM_ADDITIVE)
                 {
@@ -327,149 +369,36 @@ UObject* UC2AnimAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPare
                     Rel_Rotation = FQuat(0, 0, 0, 1);
                 }
             
-               if(UseCurveSave)
-               {
-                   for (size_t i = 0; i < KeyFrameBone.BoneRotations.Num(); i++)
-                   {
-                       auto BoneRotationKeyFrame = KeyFrameBone.BoneRotations[i];
-                       BoneRotationKeyFrame.Value *=  FQuat4f(Rel_Rotation);
-                       // Unreal uses other axis type than COD engine 
-                       FRotator3f LocalRotator = BoneRotationKeyFrame.Value.Rotator(); 
-                       LocalRotator.Yaw *= -1.0f;
-                       LocalRotator.Roll *= -1.0f;
-              
-                       BoneRotationKeyFrame.Value = LocalRotator.Quaternion();
-                       auto TimeInSeconds = static_cast<float>(BoneRotationKeyFrame.Frame) / Anim->Header.FrameRate;
-                       RotationKeysX.Add(FRichCurveKey(TimeInSeconds, LocalRotator.Pitch));
-                       RotationKeysY.Add(FRichCurveKey(TimeInSeconds, LocalRotator.Yaw));
-                       RotationKeysZ.Add(FRichCurveKey(TimeInSeconds, LocalRotator.Roll));
-                    
-                   }
-                   RotCurveKeys.Add(RotationKeysZ);
-                   RotCurveKeys.Add(RotationKeysX);
-                   RotCurveKeys.Add(RotationKeysY);
-                   for (int i = 0; i < 3; ++i)
-                   {
-                       const EVectorCurveChannel Axis = static_cast<EVectorCurveChannel>(i);
-                       UAnimationCurveIdentifierExtensions::GetTransformChildCurveIdentifier(TransformCurveId, ETransformCurveChannel::Rotation, Axis);
-                       AnimSequence->GetController().SetCurveKeys(TransformCurveId, RotCurveKeys[i], bShouldTransact);
-                   }
-               }
-        
-               else
-               {
-                   FQuat4f LastRotator;
-                   CurrentFrame = 0;
-                   for (int32 i = 0; i < KeyFrameBone.BoneRotations.Num(); ++i, ++CurrentFrame)
-                   {
-                       WraithAnimFrame<FQuat4f> BoneRotationKeyFrame = KeyFrameBone.BoneRotations[i];
-                       BoneRotationKeyFrame.Value *=  FQuat4f(Rel_Rotation);
-                       // Unreal uses other axis type than COD engine
-                       FRotator3f LocalRotator = BoneRotationKeyFrame.Value.Rotator();
-                       LocalRotator.Yaw *= -1.0f;
-                       LocalRotator.Roll *= -1.0f;
-                       FQuat4f NewRotator = LocalRotator.Quaternion();
-                    
-
-
-                    
-                       // 手动插值
-                       if (i == 0 && BoneRotationKeyFrame.Frame > 0)
-                       {
-                           while (CurrentFrame < BoneRotationKeyFrame.Frame)
-                           {
-                               RotationalKeys.Add(NewRotator);
-                               ++CurrentFrame;
-                           }
-                       }
-                       else
-                       {
-                           while (CurrentFrame < BoneRotationKeyFrame.Frame)
-                           {
-                               uint32 LastFrame = KeyFrameBone.BoneRotations[i - 1].Frame;
-                              
-                               RotationalKeys.Add(
-                                   FMath::Lerp(LastRotator, NewRotator,
-                                               static_cast<float>(CurrentFrame - LastFrame) /
-                                               static_cast<float>(BoneRotationKeyFrame.Frame - LastFrame)));
-                               
-                               ++CurrentFrame;
-                           }
-                       }
-                       LastRotator = NewRotator;
-                       RotationalKeys.Add(NewRotator);
-                   }
-               }
-
-                CurrentFrame = 0;
-                for (int32 i = 0; i < KeyFrameBone.BoneScale.Num(); ++i, ++CurrentFrame)
-                {
-                    WraithAnimFrame<FVector3f> BoneScaleKeyFrame = KeyFrameBone.BoneScale[i];
-
-                    // 手动插值
-                    if (i == 0 && BoneScaleKeyFrame.Frame > 0)
-                    {
-                        while (CurrentFrame < BoneScaleKeyFrame.Frame)
-                        {
-                            ScalingKeys.Add(BoneScaleKeyFrame.Value);
-                            ++CurrentFrame;
-                        }
-                    }
-                    else
-                    {
-                        while (CurrentFrame < BoneScaleKeyFrame.Frame)
-                        {
-                            WraithAnimFrame<FVector3f> LastScaleFrame = KeyFrameBone.BoneScale[i - 1];
-                            ScalingKeys.Add(
-                                FMath::Lerp(LastScaleFrame.Value, BoneScaleKeyFrame.Value,
-                                            static_cast<float>(CurrentFrame - LastScaleFrame.Frame) /
-                                            static_cast<float>(BoneScaleKeyFrame.Frame - LastScaleFrame.Frame)));
-                            ++CurrentFrame;
-                        }
-                    }
-                    ScalingKeys.Add(BoneScaleKeyFrame.Value);
-                }
-        
-                
-                int32 ArrLen = FMath::Max3(PositionalKeys.Num(), RotationalKeys.Num(), ScalingKeys.Num());
-                while (PositionalKeys.Num() < ArrLen)
+                for (size_t i = 0; i < KeyFrameBone.BoneRotations.Num(); i++)
                 {
-                    if (PositionalKeys.IsEmpty())
-                    {
-                        bool IsAb=Anim->Header.AnimType == ESEAnimAnimationType::SEANIM_ABSOLUTE ;
-                        PositionalKeys.Add(IsAb  ?  FVector3f::ZeroVector   :   FVector3f(BonePoseTransform.GetLocation()));
-                    }
-                    else
-                    {
-                        FVector3f LastItem = PositionalKeys.Last();
-                        PositionalKeys.Add(LastItem);
-                    }
-                }
-                while (RotationalKeys.Num() < ArrLen)
-                {
-                    if (RotationalKeys.IsEmpty())
-                    {
-                        RotationalKeys.Add(FQuat4f(BonePoseTransform.GetRotation()));
-                    }
-                    else
-                    {
-                        FQuat4f LastItem = RotationalKeys.Last();
-                        RotationalKeys.Add(LastItem);
-                    }
+                    auto BoneRotationKeyFrame = KeyFrameBone.BoneRotations[i];
+                    BoneRotationKeyFrame.Value *=  FQuat4f(Rel_Rotation);
+                    // Unreal uses other axis type than COD engine 
+                    FRotator3f LocalRotator = BoneRotationKeyFrame.Value.Rotator(); 
+                    LocalRotator.Yaw *= -1.0f;
+                    LocalRotator.Roll *= -1.0f;
+          
+                    BoneRotationKeyFrame.Value = LocalRotator.Quaternion();
+                    auto TimeInSeconds = static_cast<float>(BoneRotationKeyFrame.Frame) / Anim->Header.FrameRate;
+                    RotationKeysX.Add(FRichCurveKey(TimeInSeconds, LocalRotator.Pitch));
+                    RotationKeysY.Add(FRichCurveKey(TimeInSeconds, LocalRotator.Yaw));
+                    RotationKeysZ.Add(FRichCurveKey(TimeInSeconds, LocalRotator.Roll));
                 }
-                while (ScalingKeys.Num() < ArrLen)
+                RotCurveKeys.Add(RotationKeysZ);
+                RotCurveKeys.Add(RotationKeysX);
+                RotCurveKeys.Add(RotationKeysY);
+                for (int i = 0; i < 3; ++i)
                 {
-                    if (ScalingKeys.IsEmpty())
-                    {
-                        ScalingKeys.Add(FVector3f::OneVector);
-                    }
-                    else
-                    {
-                        FVector3f LastItem = ScalingKeys.Last();
-                        ScalingKeys.Add(LastItem);
-                    }
+                    const EVectorCurveChannel Axis = static_cast<EVectorCurveChannel>(i);
+                    UAnimationCurveIdentifierExtensions::GetTransformChildCurveIdentifier(TransformCurveId, ETransformCurveChannel::Rotation, Axis);
+                    AnimSequence->GetController().SetCurveKeys(TransformCurveId, RotCurveKeys[i], bShouldTransact);
                 }
-                Controller.SetBoneTrackKeys(NewCurveName, PositionalKeys, RotationalKeys, ScalingKeys);
+            }
+
+            if (KeyFrameBone.BoneRotations.Num() > 0)
+            {
+                const FC2Anims& Track = TracksAll[BoneIndex];
+                Controller.SetBoneTrackKeys(NewCurveName, Track.PosKeys, Track.RotKeys, Track.ScaleKeys);
             }
         }
         
@@ -492,26 +421,73 @@ UObject* UC2AnimAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPare
 
 
 
-FMeshBoneInfo UC2AnimAssetFactory::GetBone(const FString& AnimBoneName)
+void UC2AnimAssetFactory::CacheBoneIndices(const USkeleton* Skeleton)
 {
-    for (const auto& Bone : Bones)
+    // A batch usually targets one skeleton, only rebuild when it (or its bone list) changes
+    if (CachedSkeleton.Get() == Skeleton && CachedSkeletonBoneCount == Bones.Num())
     {
-        if (Bone.Name.ToString() == AnimBoneName)
-        {
-            return Bone;
-        }
+        return;
+    }
+    CachedSkeleton = Skeleton;
+    CachedSkeletonBoneCount = Bones.Num();
+    BoneIndexByName.Reset();
+    BoneIndexByName.Reserve(Bones.Num());
+    for (int32 Index = 0; Index < Bones.Num(); ++Index)
+    {
+        BoneIndexByName.Add(Bones[Index].Name, Index);
     }
-    return FMeshBoneInfo();
 }
 
-int UC2AnimAssetFactory::GetBoneIndex(const FString& AnimBoneName)
+const TArray<FTransform>& UC2AnimAssetFactory::GetRefposeOverride(const USkeleton* Skeleton)
 {
-    for (int32 Index = 0; Index < Bones.Num(); ++Index)
+    UAnimSequence* RefposeSequence = SettingsImporter->RefposeSequence;
+    if (CachedRefposeSequence.Get() == RefposeSequence && CachedRefposeSkeleton.Get() == Skeleton
+        && CachedPoseTime == SettingsImporter->PoseTime && RefposeTransforms.Num() == Bones.Num())
+    {
+        return RefposeTransforms;
+    }
+    CachedRefposeSequence = RefposeSequence;
+    CachedRefposeSkeleton = Skeleton;
+    CachedPoseTime = SettingsImporter->PoseTime;
+
+    FAnimPoseEvaluationOptions EvaluationOptions;
+    FAnimPose Pose;
+    UAnimPoseExtensions::GetAnimPoseAtFrame(RefposeSequence, SettingsImporter->PoseTime, EvaluationOptions, Pose);
+    TArray<FName> PoseBoneNames;
+    UAnimPoseExtensions::GetBoneNames(Pose, PoseBoneNames);
+    const TSet<FName> PoseBones(PoseBoneNames);
+
+    // Bones the pose doesn't have keep the identity GetBonePose would have returned for them
+    RefposeTransforms.Reset(Bones.Num());
+    for (const FMeshBoneInfo& Bone : Bones)
+    {
+        RefposeTransforms.Add(PoseBones.Contains(Bone.Name)
+            ? UAnimPoseExtensions::GetBonePose(Pose, Bone.Name, EAnimPoseSpaces::Local)
+            : FTransform::Identity);
+    }
+    return RefposeTransforms;
+}
+
+void UC2AnimAssetFactory::ResolveAnimBones(const C2Anim& Anim, TArray<int32>& OutSkeletonIndices, TBitArray<>& OutUnmatched)
+{
+    const int32 BoneCount = Anim.BonesInfos.Num();
+    OutSkeletonIndices.SetNumUninitialized(BoneCount);
+    OutUnmatched.Init(false, BoneCount);
+    for (int32 BoneIndex = 0; BoneIndex < BoneCount; ++BoneIndex)
+    {
+        const int32* Index = BoneIndexByName.Find(Anim.BonesInfos[BoneIndex].Name);
+        OutSkeletonIndices[BoneIndex] = Index ? *Index : INDEX_NONE;
+        OutUnmatched[BoneIndex] = Index == nullptr;
+    }
+
+    const int32 UnmatchedCount = OutUnmatched.CountSetBits();
+    if (UnmatchedCount > 0)
     {
-        if (Bones[Index].Name.ToString() == AnimBoneName)
+        FString Names;
+        for (TConstSetBitIterator<> It(OutUnmatched); It; ++It)
         {
-            return Index;
+            Names += (Names.IsEmpty() ? TEXT("") : TEXT(", ")) + Anim.BonesInfos[It.GetIndex()].Name.ToString();
         }
+        UE_LOG(LogTemp, Warning, TEXT("%d animated bones are not in the skeleton and will be skipped: %s"), UnmatchedCount, *Names);
     }
-    return -69;
 }
@@ -1,7 +1,8 @@
 #include "Factories/C2ModelAssetFactory.h"
 #include "Containers/UnrealString.h"
 #include "Structures/C2Mesh.h"
-#include "Misc/FileHelper.h"
+#include "Utils/C2MReader.h"
+#include "Utils/C2MParseCache.h"
 #include "AssetToolsModule.h"
 #include "Editor.h"
 // widgets
@@ -17,6 +18,8 @@
 #include "IAutomationControllerManager.h"
 #include "Interfaces/IMainFrameModule.h"
 #include "Misc/FeedbackContext.h"
+#include "Misc/ScopeExit.h"
+#include "Async/ParallelFor.h"
 #include "Subsystems/AssetEditorSubsystem.h"
 
 /* UTextAssetFactory structors
@@ -39,21 +42,28 @@ UC2ModelAssetFactory::UC2ModelAssetFactory( const FObjectInitializer& ObjectInit
 
 UObject* UC2ModelAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename, const TCHAR* Parms, FFeedbackContext* Warn, bool& bOutOperationCanceled)
 {
-	// Load C2M File
-	TArray64<uint8> FileDataOld;
-	if (!FFileHelper::LoadFileToArray(FileDataOld, *Filename))
+	// Map C2M File
+	C2MFileReader Reader;
+	if (!Reader.Open(Filename))
 	{
 		return nullptr;
 	}
 	// Create our base  Asset
 	UObject* MeshCreated = nullptr;
-	FString FileName_Fix = Filename.Replace(TEXT("_LOD0"),TEXT(""));
-	FLargeMemoryReader Reader(FileDataOld.GetData(), FileDataOld.Num());
-	C2Mesh* Mesh = new C2Mesh();
-	Mesh->ParseMesh(Reader);
-	Mesh->Header->MeshName =  FPaths::GetBaseFilename(FileName_Fix);
+	FString FileName_Fix = FPaths::GetBaseFilename(Filename).Replace(TEXT("_LOD0"),TEXT(""));
+	// Everything parsed from the file lives in the arena and is released in one go, whichever way we leave
+	ON_SCOPE_EXIT
+	{
+		ParseArena.LogUsage(FPaths::GetCleanFilename(Filename));
+		ParseArena.Reset();
+	};
 	if (!UserSettings->bInitialized)
 	{
+		// The dialog only needs the header, bone names and vertex count, the full parse waits until the user confirms
+		C2MeshProbe Probe;
+		C2Mesh::Probe(Reader, Probe);
+		Reader.Seek(0);
+		Probe.Header.MeshName = FileName_Fix;
 		TSharedPtr<SMeshImportOptions> ImportOptionsWindow;
 		TSharedPtr<SWindow> ParentWindow;
 		if (FModuleManager::Get().IsModuleLoaded("MainFrame"))
@@ -69,50 +79,73 @@ UObject* UC2ModelAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPar
 		(
 			SAssignNew(ImportOptionsWindow, SMeshImportOptions)
 			.WidgetWindow(Window)
-			.MeshHeader(Mesh)
+			.MeshProbe(&Probe)
 		);
 		UserSettings = ImportOptionsWindow.Get()->Options;
-		if (Mesh->Bones.Num() > 1)
+		if (Probe.BoneNames.Num() > 1)
 		{
 			UserSettings->MeshType = EMeshType::SkeletalMesh;
 		}
 		FSlateApplication::Get().AddModalWindow(Window, ParentWindow, false);
 		bImport = ImportOptionsWindow.Get()->ShouldImport();
 		bImportAll = ImportOptionsWindow.Get()->ShouldImportAll();
+		if (!bImport && !bImportAll)
+		{
+			bOutOperationCanceled = true;
+			return nullptr;
+		}
 		UserSettings->bInitialized = true;
 	}
+	// Greyhound writes the lower LODs next to LOD0, they all end up in the same mesh
+	const TArray<C2Mesh*> LODMeshes = ParseLODs(Filename, Reader);
+	C2Mesh* Mesh = LODMeshes[0];
+	Mesh->Header->MeshName = FileName_Fix;
 	if (!UserSettings->bImportMaterials)
 	{
-		Mesh->Materials.Empty();
+		for (C2Mesh* LODMesh : LODMeshes)
+		{
+			LODMesh->Materials.Empty();
+		}
 	}
 	FString DiskTexturesPath = FPaths::GetPath(FPaths::GetPath(Filename)) + "/_images/";
 	TArray<C2Material*> C2Materials;
 	FString UnrealTexturesPath = BaseDestPath + Mesh->Header->GameName + "Textures";
-	for (size_t i = 0; i < Mesh->Materials.Num(); i++)
+	// LOD0's table comes first so its indices stay valid, lower LODs only add the materials LOD0 does not use
+	TSet<FString> MaterialNames;
+	for (const C2Mesh* LODMesh : LODMeshes)
 	{
-		auto mat = Mesh->Materials[i];
-		C2Material* CoDMaterial = new C2Material();
-		CoDMaterial->Header->MaterialName = mat.MaterialName;
-		for (size_t t = 0; t < mat.TextureNames.Num(); t++)
+		for (size_t i = 0; i < LODMesh->Materials.Num(); i++)
 		{
-			auto Texture = mat.TextureNames[t];
-			C2MTexture CodTexture;
-			CodTexture.TexturePath = Texture;
-			CodTexture.TextureName = FPaths::GetCleanFilename(Texture).Replace(TEXT(".png"), TEXT(""));
-			CodTexture.TextureType = mat.TextureTypes[t];
+			auto mat = LODMesh->Materials[i];
+			bool bKnownMaterial = false;
+			MaterialNames.Add(mat.MaterialName, &bKnownMaterial);
+			if (LODMesh != Mesh && bKnownMaterial)
+			{
+				continue;
+			}
+			C2Material* CoDMaterial = ParseArena.New<C2Material>();
+			CoDMaterial->Header->MaterialName = mat.MaterialName;
+			for (size_t t = 0; t < mat.TextureNames.Num(); t++)
+			{
+				auto Texture = mat.TextureNames[t];
+				C2MTexture CodTexture;
+				CodTexture.TexturePath = Texture;
+				CodTexture.TextureName = FPaths::GetCleanFilename(Texture).Replace(TEXT(".png"), TEXT(""));
+				CodTexture.TextureType = mat.TextureTypes[t];
 
-			FString FixedTexture = Texture.Replace(TEXT("\\_images\\"), TEXT(""));
+				FString FixedTexture = Texture.Replace(TEXT("\\_images\\"), TEXT(""));
 
-			FString FixedImageFilePath = DiskTexturesPath + FixedTexture;
-			if (FPaths::FileExists(FixedImageFilePath))
-			{
-				CodTexture.TextureObject = ImportTexture(FixedImageFilePath, InParent);
+				FString FixedImageFilePath = DiskTexturesPath + FixedTexture;
+				if (FPaths::FileExists(FixedImageFilePath))
+				{
+					CodTexture.TextureObject = ImportTexture(FixedImageFilePath, InParent);
+				}
+				else
+					CodTexture.TextureObject = nullptr;
+				CoDMaterial->Textures.Add(CodTexture);
 			}
-			else
-				CodTexture.TextureObject = nullptr;
-			CoDMaterial->Textures.Add(CodTexture);
+			C2Materials.Add(CoDMaterial);
 		}
-		C2Materials.Add(CoDMaterial);
 	}
 	// Model Stuff
 	FString ModelPackage = FPaths::Combine(TEXT("/Game"), Mesh->Header->GameName, TEXT("Models"));
@@ -127,7 +160,7 @@ UObject* UC2ModelAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPar
 		}
 	}
 
-	MeshCreated = MeshBuildingClass.CreateMesh(InParent,ModelPackage,Mesh,C2Materials);
+	MeshCreated = MeshBuildingClass.CreateMesh(InParent,ModelPackage,LODMeshes,C2Materials);
 
 	if (MeshCreated)
 	{
@@ -138,6 +171,57 @@ UObject* UC2ModelAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InPar
 	return MeshCreated;
 }
 
+TArray<C2Mesh*> UC2ModelAssetFactory::ParseLODs(const FString& Filename, C2MReader& BaseReader)
+{
+	TArray<FString> LODFiles;
+	// Only the file name carries the LOD suffix, a directory that happens to contain "_LOD0" stays as it is
+	const FString BaseName = FPaths::GetBaseFilename(Filename);
+	if (BaseName.Contains(TEXT("_LOD0")))
+	{
+		for (int32 LODIndex = 1; LODIndex < MAX_STATIC_MESH_LODS; LODIndex++)
+		{
+			const FString LODName = BaseName.Replace(TEXT("_LOD0"), *FString::Printf(TEXT("_LOD%d"), LODIndex));
+			const FString LODFile = FPaths::Combine(FPaths::GetPath(Filename), LODName + FPaths::GetExtension(Filename, true));
+			if (!FPaths::FileExists(LODFile))
+			{
+				break;
+			}
+			LODFiles.Add(LODFile);
+		}
+	}
+	// The arena is shared by every LOD, readers live in it too so mapped files stay valid until it is reset
+	TArray<C2Mesh*> LODMeshes;
+	LODMeshes.SetNumZeroed(LODFiles.Num() + 1);
+	ParallelFor(LODMeshes.Num(), [&](int32 LODIndex)
+	{
+		C2MReader* Reader = &BaseReader;
+		if (LODIndex > 0)
+		{
+			C2MFileReader* LODReader = ParseArena.New<C2MFileReader>();
+			if (!LODReader->Open(LODFiles[LODIndex - 1]))
+			{
+				return;
+			}
+			Reader = LODReader;
+		}
+		C2Mesh* LODMesh = ParseArena.New<C2Mesh>(ParseArena);
+		C2MParseCache::ParseMesh(*Reader, *LODMesh, ParseArena);
+		// A sibling that fails to parse is treated like one that cannot be opened, the list is cut there
+		if (LODIndex > 0 && Reader->IsError())
+		{
+			return;
+		}
+		LODMeshes[LODIndex] = LODMesh;
+	}, EParallelForFlags::Unbalanced);
+	const int32 FirstMissing = LODMeshes.Find(nullptr);
+	if (FirstMissing != INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("'%s' could not be opened or parsed, only the LODs before it are imported"), *LODFiles[FirstMissing - 1]);
+		LODMeshes.SetNum(FirstMissing);
+	}
+	return LODMeshes;
+}
+
 UObject* UC2ModelAssetFactory::ImportTexture(FString FilePath,UObject* InParent)
 {
 
@@ -1,15 +1,92 @@
 ﻿#include "Structures/C2Anim.h"
 #include "Structures/C2Material.h"
+#include "Math/VectorRegister.h"
+#include "Async/ParallelFor.h"
 
-void C2Anim::ParseAnim(FLargeMemoryReader& Reader)
+// Longest run of keys one segment may replace. Checking a segment is linear in its length, so without a cap
+// a long linear move would cost quadratic time
+static constexpr int32 MaxReducedSpan = 64;
+
+/* Greedy reduction: extend a segment from the last kept key for as long as Fits(Start, End, Alpha, Value)
+ * holds for every key it skips, then keep the key before the one that broke it */
+template <typename T, typename FitsType>
+static void ReduceTrack(C2AnimTrack<T>& Track, FitsType Fits)
+{
+	const int32 KeyCount = Track.Num();
+	if (KeyCount < 2)
+	{
+		return;
+	}
+	TArray<uint32_t>& Frames = Track.Frames;
+	TArray<T>& Values = Track.Values;
+
+	bool bConstant = true;
+	for (int32 Key = 1; Key < KeyCount && bConstant; Key++)
+	{
+		bConstant = Fits(Values[0], Values[0], 0.0f, Values[Key]);
+	}
+	if (bConstant)
+	{
+		// Frames before the first key hold it anyway, so frame 0 gives the same samples
+		Frames.SetNum(1);
+		Values.SetNum(1);
+		Frames[0] = 0;
+		return;
+	}
+
+	int32 Kept = 1;
+	int32 Anchor = 0;
+	for (int32 Candidate = 2; Candidate < KeyCount; Candidate++)
+	{
+		const float Span = static_cast<float>(Frames[Candidate]) - static_cast<float>(Frames[Anchor]);
+		bool bFits = Span > 0.0f && Candidate - Anchor <= MaxReducedSpan;
+		for (int32 Key = Anchor + 1; Key < Candidate && bFits; Key++)
+		{
+			const float Alpha = (static_cast<float>(Frames[Key]) - static_cast<float>(Frames[Anchor])) / Span;
+			bFits = Fits(Values[Anchor], Values[Candidate], Alpha, Values[Key]);
+		}
+		if (!bFits)
+		{
+			// Kept keys are compacted to the front as we go, Anchor indexes the original arrays
+			Anchor = Candidate - 1;
+			Frames[Kept] = Frames[Anchor];
+			Values[Kept] = Values[Anchor];
+			Kept++;
+		}
+	}
+	Frames[Kept] = Frames[KeyCount - 1];
+	Values[Kept] = Values[KeyCount - 1];
+	Kept++;
+	Frames.SetNum(Kept);
+	Values.SetNum(Kept);
+}
+
+void C2Anim::ParseAnim(C2MReader& Reader)
 {
 	ParseHeader(Reader);
-	const TArray<FString> BoneNames = ParseBoneNames(Reader);
+	const TArray<FName> BoneNames = ParseBoneNames(Reader);
 	const TArray<AnimationBoneModifier> AnimModifiers = ParseAnimModifiers(Reader);
+	if (bHasFrameRange && Header.FrameCountBuffer > 0)
+	{
+		RangeEnd = FMath::Min(RangeEnd, Header.FrameCountBuffer - 1);
+		RangeStart = FMath::Min(RangeStart, RangeEnd);
+	}
 	ParseBoneData(Reader, AnimModifiers, BoneNames);
+	// Frame indices are sized from the file's frame count, so the header only switches to the slice once the keys are read
+	if (bHasFrameRange && Header.FrameCountBuffer > 0)
+	{
+		Header.FrameCountBuffer = RangeEnd - RangeStart + 1;
+	}
 }
 
-void C2Anim::ParseHeader(FLargeMemoryReader& Reader)
+void C2Anim::SetFrameRange(uint32_t StartFrame, uint32_t EndFrame)
+{
+	bHasFrameRange = true;
+	RangeStart = StartFrame;
+	RangeEnd = FMath::Max(StartFrame, EndFrame);
+}
+
+void C2Anim::ParseHeader(C2MReader& Reader)
 {
 	Reader.ByteOrderSerialize(&Header.Magic, sizeof(Header.Magic));
 	Reader << Header.Version;
@@ -27,19 +104,28 @@ void C2Anim::ParseHeader(FLargeMemoryReader& Reader)
 	Reader << Header.NotificationBuffer;
 }
 
-TArray<FString> C2Anim::ParseBoneNames(FLargeMemoryReader& Reader) const
+TArray<FName> C2Anim::ParseBoneNames(C2MReader& Reader) const
 {
-	TArray<FString> BoneNames;
+	TArray<FName> BoneNames;
+	// Every name takes at least its terminator, a corrupt count can't reserve more than the file holds
+	BoneNames.Reserve(FMath::Min<int64>(Header.BoneCountBuffer, Reader.GetRemaining()));
 	for (uint32_t an_id = 0; an_id < Header.BoneCountBuffer; an_id++)
 	{
-		FString bName;
-		BinaryReader::readString(Reader, &bName);
-		BoneNames.Add(bName);
+		BoneNames.Add(BinaryReader::readName(Reader));
 	}
 	return BoneNames;
 }
 
-TArray<AnimationBoneModifier> C2Anim::ParseAnimModifiers(FLargeMemoryReader& Reader) const
+bool C2Anim::Probe(C2MReader& Reader, C2AnimProbe& OutProbe)
+{
+	C2Anim Anim;
+	Anim.ParseHeader(Reader);
+	OutProbe.Header = Anim.Header;
+	OutProbe.BoneNames = Anim.ParseBoneNames(Reader);
+	return !Reader.IsError();
+}
+
+TArray<AnimationBoneModifier> C2Anim::ParseAnimModifiers(C2MReader& Reader) const
 {
 	TArray<AnimationBoneModifier> AnimModifiers;
 	for (uint8_t an_mo = 0; an_mo < Header.AnimationBoneModifiers; an_mo++)
@@ -67,127 +153,238 @@ TArray<AnimationBoneModifier> C2Anim::ParseAnimModifiers(FLargeMemoryReader& Rea
 	return AnimModifiers;
 }
 
-void C2Anim::ParseBoneData(FLargeMemoryReader& Reader, const TArray<AnimationBoneModifier>& AnimModifiers, const TArray<FString>& BoneNames)
+void C2Anim::ParseBoneData(C2MReader& Reader, const TArray<AnimationBoneModifier>& AnimModifiers, const TArray<FName>& BoneNames)
+{
+	if (Header.FrameCountBuffer <= 0xFF)
+	{
+		ParseBoneTracks<uint8_t>(Reader, BoneNames);
+	}
+	else if (Header.FrameCountBuffer <= 0xFFFF)
+	{
+		ParseBoneTracks<uint16_t>(Reader, BoneNames);
+	}
+	else
+	{
+		ParseBoneTracks<uint32_t>(Reader, BoneNames);
+	}
+}
+
+template <typename FrameIndexType>
+void C2Anim::ParseBoneTracks(C2MReader& Reader, const TArray<FName>& BoneNames)
 {
+	const bool bHasLocations = (Header.DataFlag & static_cast<uint8_t>(ESEAnimDataPresenceFlags::SEANIM_BONE_LOC)) != 0;
+	const bool bHasRotations = (Header.DataFlag & static_cast<uint8_t>(ESEAnimDataPresenceFlags::SEANIM_BONE_ROT)) != 0;
+	const bool bHasScales = (Header.DataFlag & static_cast<uint8_t>(ESEAnimDataPresenceFlags::SEANIM_BONE_SCALE)) != 0;
 
+	BonesInfos.Reserve(BonesInfos.Num() + Header.BoneCountBuffer);
 	for (uint32_t an_tag = 0; an_tag < Header.BoneCountBuffer; an_tag++)
 	{
-		TArray<WraithAnimFrame<FVector3f>> Locations;
-		TArray<WraithAnimFrame<FVector3f>> Scales;
-		TArray<WraithAnimFrame<FQuat4f>> Rotations;
-		BoneInfo o_BoneInfo;
+		BoneInfo& o_BoneInfo = BonesInfos.AddDefaulted_GetRef();
 		o_BoneInfo.Name = BoneNames[an_tag];
 		o_BoneInfo.index = an_tag;
 
 		uint8_t random_flag;
 		Reader << random_flag;
-		if (static_cast<uint8_t>(Header.DataFlag) & static_cast<uint8_t>(ESEAnimDataPresenceFlags::SEANIM_BONE_LOC))
+		if (bHasFrameRange)
+		{
+			if (bHasLocations)
+			{
+				ParseKeyframeRange<FrameIndexType>(Reader, o_BoneInfo.BonePositions, RangeStart, RangeEnd);
+			}
+			if (bHasRotations)
+			{
+				ParseKeyframeRange<FrameIndexType>(Reader, o_BoneInfo.BoneRotations, RangeStart, RangeEnd);
+			}
+			if (bHasScales)
+			{
+				ParseKeyframeRange<FrameIndexType>(Reader, o_BoneInfo.BoneScale, RangeStart, RangeEnd);
+			}
+			continue;
+		}
+		if (bHasLocations)
 		{
-			ParseKeyframeData<FVector3f>(Reader, o_BoneInfo.BonePositions);
+			ParseKeyframeData<FrameIndexType>(Reader, o_BoneInfo.BonePositions);
 		}
-		if (static_cast<uint8_t>(Header.DataFlag) & static_cast<uint8_t>(ESEAnimDataPresenceFlags::SEANIM_BONE_ROT))
+		if (bHasRotations)
 		{
-			ParseKeyframeData<FQuat4f>(Reader, o_BoneInfo.BoneRotations);
+			ParseKeyframeData<FrameIndexType>(Reader, o_BoneInfo.BoneRotations);
 		}
-		if (static_cast<uint8_t>(Header.DataFlag) & static_cast<uint8_t>(ESEAnimDataPresenceFlags::SEANIM_BONE_SCALE))
+		if (bHasScales)
 		{
-			ParseKeyframeData<FVector3f>(Reader, o_BoneInfo.BoneScale);
+			ParseKeyframeData<FrameIndexType>(Reader, o_BoneInfo.BoneScale);
 		}
-		BonesInfos.Add(o_BoneInfo);
 	}
-
 }
-FQuat4f C2Anim::FixRotationAbsolute(FQuat4f QuatRot, FQuat4f InitialRot)
+
+void C2Anim::ReduceKeys(float PositionTolerance, float RotationToleranceDegrees, float ScaleTolerance)
 {
-	if (FMath::Abs(QuatRot.X) <= 0.0005)
+	// Same interpolation the resampler uses, so every removed key is reproduced within tolerance
+	const float PositionToleranceSquared = FMath::Square(PositionTolerance);
+	const float ScaleToleranceSquared = FMath::Square(ScaleTolerance);
+	auto PositionFits = [PositionToleranceSquared](const FVector3f& Start, const FVector3f& End, float Alpha, const FVector3f& Value)
 	{
-		QuatRot.X = InitialRot.X;
-	}
-	if (FMath::Abs(QuatRot.Y) <= 0.0005)
+		return FVector3f::DistSquared(FMath::Lerp(Start, End, Alpha), Value) <= PositionToleranceSquared;
+	};
+	auto ScaleFits = [ScaleToleranceSquared](const FVector3f& Start, const FVector3f& End, float Alpha, const FVector3f& Value)
 	{
-		QuatRot.Y = InitialRot.Y;
-	}
-	if (FMath::Abs(QuatRot.Z) <= 0.0005)
+		return FVector3f::DistSquared(FMath::Lerp(Start, End, Alpha), Value) <= ScaleToleranceSquared;
+	};
+	// Two unit quaternions are within Angle of each other when |dot| >= cos(Angle / 2)
+	const float MinRotationDot = FMath::Cos(FMath::DegreesToRadians(RotationToleranceDegrees) * 0.5f);
+	auto RotationFits = [MinRotationDot](const FQuat4f& Start, const FQuat4f& End, float Alpha, const FQuat4f& Value)
 	{
-		QuatRot.Z = InitialRot.Z;
-	}
-	if (FMath::Abs(QuatRot.W) <= 0.0005)
-	{
-		QuatRot.W = InitialRot.W;
-	}
+		const FQuat4f Interpolated = FQuat4f::FastLerp(Start, (Start | End) < 0.0f ? -End : End, Alpha).GetNormalized();
+		return FMath::Abs(Interpolated | Value.GetNormalized()) >= MinRotationDot;
+	};
 
-	if (FMath::Abs(QuatRot.X) <= 0.0005 && FMath::Abs(QuatRot.Y) <= 0.0005 && FMath::Abs(QuatRot.Z) <= 0.0005 && FMath::Abs(QuatRot.W) <= 0.0005)
+	ParallelFor(BonesInfos.Num(), [&](int32 BoneIndex)
 	{
-		QuatRot = InitialRot;
-	}
+		BoneInfo& Bone = BonesInfos[BoneIndex];
+		ReduceTrack(Bone.BonePositions, PositionFits);
+		ReduceTrack(Bone.BoneRotations, RotationFits);
+		ReduceTrack(Bone.BoneScale, ScaleFits);
+	});
+}
+
+// Replacing each near zero component also covers the all-zero case: every lane then comes from the initial pose
+static const VectorRegister4Float FixThreshold = MakeVectorRegisterFloat(0.0005f, 0.0005f, 0.0005f, 0.0005f);
+
+FQuat4f C2Anim::FixRotationAbsolute(FQuat4f QuatRot, FQuat4f InitialRot)
+{
+	FixRotationsAbsolute(MakeArrayView(&QuatRot, 1), InitialRot);
 	return QuatRot;
 }
 FVector3f C2Anim::FixPositionAbsolute(FVector3f QuatPos, FVector3f InitialPos)
 {
-	if (FMath::Abs(QuatPos.X) <= 0.0005)
+	FixPositionsAbsolute(MakeArrayView(&QuatPos, 1), InitialPos);
+	return QuatPos;
+}
+void C2Anim::FixRotationsAbsolute(TArrayView<FQuat4f> Rotations, const FQuat4f& InitialRot)
+{
+	const VectorRegister4Float Initial = VectorLoad(&InitialRot.X);
+	for (FQuat4f& Rotation : Rotations)
 	{
-		QuatPos.X = InitialPos.X;
+		const VectorRegister4Float Value = VectorLoad(&Rotation.X);
+		const VectorRegister4Float NearZero = VectorCompareLE(VectorAbs(Value), FixThreshold);
+		VectorStore(VectorSelect(NearZero, Initial, Value), &Rotation.X);
 	}
-	if (FMath::Abs(QuatPos.Y) <= 0.0005)
+}
+void C2Anim::FixPositionsAbsolute(TArrayView<FVector3f> Positions, const FVector3f& InitialPos)
+{
+	const VectorRegister4Float Initial = VectorLoadFloat3(&InitialPos);
+	for (FVector3f& Position : Positions)
 	{
-		QuatPos.Y = InitialPos.Y;
+		const VectorRegister4Float Value = VectorLoadFloat3(&Position);
+		const VectorRegister4Float NearZero = VectorCompareLE(VectorAbs(Value), FixThreshold);
+		VectorStoreFloat3(VectorSelect(NearZero, Initial, Value), &Position);
 	}
-	if (FMath::Abs(QuatPos.Z) <= 0.0005)
+}
+template <typename FrameIndexType, typename T>
+void C2Anim::ParseKeyframeData(C2MReader& Reader, C2AnimTrack<T>& Track)
+{
+	FrameIndexType KeyCountValue = 0;
+	Reader << KeyCountValue;
+	const uint32_t KeyCount = KeyCountValue;
+
+	// Keys are fixed size (frame index + value), view the whole block and split it into the frame and value arrays
+	constexpr int64 KeyStride = sizeof(FrameIndexType) + sizeof(T);
+	const TArrayView<const uint8> KeyBlock = BinaryReader::readListView<uint8>(Reader, KeyCount * KeyStride);
+	if (KeyCount == 0 || KeyBlock.Num() != KeyCount * KeyStride)
 	{
-		QuatPos.Z = InitialPos.Z;
+		return;
 	}
-
-	if (FMath::Abs(QuatPos.X) <= 0.0005 && FMath::Abs(QuatPos.Y) <= 0.0005 && FMath::Abs(QuatPos.Z) <= 0.0005)
+	const int32 FirstKey = Track.Frames.Num();
+	Track.Frames.SetNumUninitialized(FirstKey + KeyCount);
+	Track.Values.SetNumUninitialized(FirstKey + KeyCount);
+	uint32_t* Frames = Track.Frames.GetData() + FirstKey;
+	T* Values = Track.Values.GetData() + FirstKey;
+	const uint8* Key = KeyBlock.GetData();
+	for (uint32_t key = 0; key < KeyCount; key++, Key += KeyStride)
 	{
-		QuatPos = InitialPos;
+		Frames[key] = BinaryReader::readUnaligned<FrameIndexType>(Key);
+		Values[key] = BinaryReader::readUnaligned<T>(Key + sizeof(FrameIndexType));
 	}
-	return QuatPos;
 }
-template <typename T>
-void C2Anim::ParseKeyframeData(FLargeMemoryReader& Reader, TArray<WraithAnimFrame<T>>& KeyframeArray)
+
+// Same interpolation the resampler uses between two keys
+static FVector3f InterpolateKey(const FVector3f& Start, const FVector3f& End, float Alpha)
 {
-	WraithAnimFrame<T> AnimFrame;
-	uint32_t keys;
-	if (Header.FrameCountBuffer <= 0xFF)
-	{
-		uint8_t byteIndex;
-		Reader << byteIndex;
-		keys = byteIndex;
-	}
-	else if (Header.FrameCountBuffer <= 0xFFFF)
+	return FMath::Lerp(Start, End, Alpha);
+}
+static FQuat4f InterpolateKey(const FQuat4f& Start, const FQuat4f& End, float Alpha)
+{
+	return FQuat4f::FastLerp(Start, (Start | End) < 0.0f ? -End : End, Alpha).GetNormalized();
+}
+
+template <typename FrameIndexType, typename T>
+void C2Anim::ParseKeyframeRange(C2MReader& Reader, C2AnimTrack<T>& Track, uint32_t StartFrame, uint32_t EndFrame)
+{
+	FrameIndexType KeyCountValue = 0;
+	Reader << KeyCountValue;
+	const uint32_t KeyCount = KeyCountValue;
+
+	constexpr int64 KeyStride = sizeof(FrameIndexType) + sizeof(T);
+	const TArrayView<const uint8> KeyBlock = BinaryReader::readListView<uint8>(Reader, KeyCount * KeyStride);
+	if (KeyCount == 0 || KeyBlock.Num() != KeyCount * KeyStride)
 	{
-		uint16_t byte16;
-		Reader << byte16;
-		keys = byte16;
+		return;
 	}
-	else
+	// Never more keys than frames in the slice, plus the two interpolated boundary keys
+	const uint32_t MaxKept = FMath::Min<uint32_t>(KeyCount, EndFrame - StartFrame + 1) + 2;
+	Track.Frames.Reserve(Track.Frames.Num() + MaxKept);
+	Track.Values.Reserve(Track.Values.Num() + MaxKept);
+	auto AddKey = [&Track](uint32_t Frame, const T& Value)
 	{
-		Reader << keys;
-	}
+		Track.Frames.Add(Frame);
+		Track.Values.Add(Value);
+	};
 
-	for (uint32_t key = 0; key < keys; key++)
+	// Last key seen before the current one, either just ahead of the slice or the last one kept
+	bool bHasPrevious = false;
+	bool bKeptAny = false;
+	uint32_t PreviousFrame = 0;
+	T PreviousValue{};
+	const uint8* Key = KeyBlock.GetData();
+	for (uint32_t key = 0; key < KeyCount; key++, Key += KeyStride)
 	{
-		uint32_t keyFrame;
-		if (Header.FrameCountBuffer <= 0xFF)
+		const uint32_t Frame = BinaryReader::readUnaligned<FrameIndexType>(Key);
+		const T Value = BinaryReader::readUnaligned<T>(Key + sizeof(FrameIndexType));
+		if (Frame < StartFrame)
 		{
-			uint8_t byteIndex;
-			Reader << byteIndex;
-			keyFrame = byteIndex;
+			bHasPrevious = true;
+			PreviousFrame = Frame;
+			PreviousValue = Value;
+			continue;
 		}
-		else if (Header.FrameCountBuffer <= 0xFFFF)
+		if (!bKeptAny && bHasPrevious && Frame > StartFrame)
 		{
-			uint16_t byte16;
-			Reader << byte16;
-			keyFrame = byte16;
+			const float Alpha = float(StartFrame - PreviousFrame) / float(Frame - PreviousFrame);
+			AddKey(0, InterpolateKey(PreviousValue, Value, Alpha));
+			bKeptAny = true;
 		}
-		else
+		if (Frame > EndFrame)
 		{
-			Reader << keyFrame;
+			if (!bHasPrevious)
+			{
+				// The channel only starts after the slice, hold its first key
+				AddKey(0, Value);
+			}
+			else if (PreviousFrame < EndFrame && StartFrame < EndFrame)
+			{
+				const float Alpha = float(EndFrame - PreviousFrame) / float(Frame - PreviousFrame);
+				AddKey(EndFrame - StartFrame, InterpolateKey(PreviousValue, Value, Alpha));
+			}
+			return;
 		}
-		AnimFrame.Frame = keyFrame;
-		T KeyValue;
-		Reader << KeyValue;
-		AnimFrame.Value = KeyValue;
-		KeyframeArray.Add(AnimFrame);
+		AddKey(Frame - StartFrame, Value);
+		bKeptAny = true;
+		bHasPrevious = true;
+		PreviousFrame = Frame;
+		PreviousValue = Value;
+	}
+	if (!bKeptAny && bHasPrevious)
+	{
+		// The channel ends before the slice, hold its last key
+		AddKey(0, PreviousValue);
 	}
 }
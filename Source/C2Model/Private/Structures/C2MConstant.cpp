@@ -4,7 +4,7 @@ C2MConstant::C2MConstant()
 {
 	// Default
 }
-void C2MConstant::ParseConstant(FLargeMemoryReader& Reader)
+void C2MConstant::ParseConstant(C2MReader& Reader)
 {
 	Reader << Hash;
 	Reader << Value;
@@ -1,6 +1,9 @@
 ﻿#include "Structures/C2MSurface.h"
 #include "Structures/C2Mesh.h"
 #include "SocketTypes.h"
+#include "Utils/C2MUtilsImport.h"
+
+static_assert(sizeof(FVector3f) == 12 && sizeof(FVector2f) == 8 && sizeof(GfxColor) == 4, "Vertex streams must match the file layout");
 
 C2MSurface::C2MSurface()
 {
@@ -20,7 +23,13 @@ C2MSurface::C2MSurface(FString InName)
 	UVCount = 0;
 }
 
-void C2MSurface::ParseSurface(FLargeMemoryReader& Reader,uint32_t buffer_BoneCount,uint16_t surfCount,int global_SurfVertCounter )
+void C2MSurface::ParseSurface(C2MReader& Reader, StreamDecoder DecodeStreams, uint32_t buffer_BoneCount,uint16_t surfCount,int global_SurfVertCounter )
+{
+	ParseSurfaceHeader(Reader, buffer_BoneCount, surfCount, global_SurfVertCounter);
+	ParseSurfaceBody(Reader, DecodeStreams);
+}
+
+void C2MSurface::ParseSurfaceHeader(C2MReader& Reader, uint32_t buffer_BoneCount, uint16_t surfCount, int global_SurfVertCounter)
 {
 	// Initialize Class Vars
 	Surface_VertexCounter = global_SurfVertCounter;
@@ -34,112 +43,230 @@ void C2MSurface::ParseSurface(FLargeMemoryReader& Reader,uint32_t buffer_BoneCou
 
 	// Set the surface name
 	Name = FString::Format(TEXT("surf_{0}"), { surfCount });
+}
 
-	for (size_t i = 0; i < VertCount; i++)
+int64 C2MSurface::GetBodySize(const C2MeshHeader& Header) const
+{
+	using EMeshFlags = C2MeshHeader::SEModelMeshPresenceFlags;
+	const int64 Verts = VertCount;
+	const int64 BoneIndexSize = BoneCountBuffer <= 0xFF ? 1 : (BoneCountBuffer <= 0xFFFF ? 2 : 4);
+	const int64 FaceIndexSize = VertCount <= 0xFF ? 1 : (VertCount <= 0xFFFF ? 2 : 4);
+
+	int64 Size = Verts * sizeof(FVector3f);
+	if (Header.HasMeshData(EMeshFlags::SEMODEL_PRESENCE_UVSET))
 	{
-		C2MVertex Vertex;
-		Reader << Vertex.Vertice;
-		Vertexes.Add(Vertex);
+		Size += Verts * MaterialCount * sizeof(FVector2f);
 	}
-	
-	for (size_t i = 0; i < VertCount; i++)
+	if (Header.HasMeshData(EMeshFlags::SEMODEL_PRESENCE_NORMALS))
 	{
-		C2MVertex& Vertex = Vertexes[i];
-		Reader << Vertex.UV;
+		Size += Verts * sizeof(FVector3f);
 	}
-	for (size_t i = 0; i < VertCount; i++)
+	if (Header.HasMeshData(EMeshFlags::SEMODEL_PRESENCE_COLOR))
 	{
-		C2MVertex& Vertex = Vertexes[i];
-		Reader << Vertex.Normal;
+		Size += Verts * sizeof(GfxColor);
 	}
-	for (size_t i = 0; i < VertCount; i++)
+	if (Header.HasMeshData(EMeshFlags::SEMODEL_PRESENCE_WEIGHTS))
 	{
-		C2MVertex& Vertex = Vertexes[i];
-		Reader << Vertex.Color;
+		Size += Verts * MaxSkinBuffer * (BoneIndexSize + sizeof(float));
 	}
-	for (size_t i = 0; i < VertCount; i++)
+	Size += static_cast<int64>(FaceCount) * 3 * FaceIndexSize;
+	Size += static_cast<int64>(MaterialCount) * sizeof(int32_t);
+	return Size;
+}
+
+int64 C2MSurface::GetDecodedSize(const C2MeshHeader& Header) const
+{
+	using EMeshFlags = C2MeshHeader::SEModelMeshPresenceFlags;
+	const int64 Verts = VertCount;
+	// Positions and faces are always there, every stream may be padded up to the arena alignment
+	int64 Size = Verts * sizeof(FVector3f) + static_cast<int64>(FaceCount) * sizeof(GfxFace) + 2 * 16;
+	if (Header.HasMeshData(EMeshFlags::SEMODEL_PRESENCE_UVSET))
 	{
-		C2MVertex& Vertex = Vertexes[i];
-		Vertex.Weights = ParseWeight(Reader, i);
+		Size += Verts * MaterialCount * sizeof(FVector2f) + 16;
 	}
-	//
-    Faces = ParseFaces(Reader);
-	Materials = BinaryReader::readList<int32_t>(Reader, MaterialCount);
+	if (Header.HasMeshData(EMeshFlags::SEMODEL_PRESENCE_NORMALS))
+	{
+		Size += Verts * sizeof(FVector3f) + 16;
+	}
+	if (Header.HasMeshData(EMeshFlags::SEMODEL_PRESENCE_COLOR))
+	{
+		Size += Verts * sizeof(GfxColor) + 16;
+	}
+	if (Header.HasMeshData(EMeshFlags::SEMODEL_PRESENCE_WEIGHTS))
+	{
+		Size += Verts * MaxSkinBuffer * (sizeof(uint32_t) + sizeof(float)) + 2 * 16;
+	}
+	return Size;
 }
 
-
-TArray<GfxFace> C2MSurface::ParseFaces(FLargeMemoryReader& Reader)
+void C2MSurface::ParseSurfaceBody(C2MReader& Reader, StreamDecoder DecodeStreams)
 {
-    TArray<GfxFace> allFaces;
-    for (uint32_t i = 0; i < FaceCount; i++)
-    {
-        GfxFace face;
-        if (VertCount <= 0xFF)
-        {
-            // Read as byte
-            uint8_t index1, index2, index3;
-            Reader << index3;
-            Reader << index2;
-            Reader << index1;
-            face.index[0] = index1 + Surface_VertexCounter;
-            face.index[1] = index2 + Surface_VertexCounter;
-            face.index[2] = index3 + Surface_VertexCounter;
-        }
-        else if (VertCount <= 0xFFFF)
-        {
-            // Read as short
-            uint16_t index1, index2, index3;
-            Reader << index3;
-            Reader << index2;
-            Reader << index1;
-        	face.index[0] = index1 + Surface_VertexCounter;
-        	face.index[1] = index2 + Surface_VertexCounter;
-        	face.index[2] = index3 + Surface_VertexCounter;
-        }
-        else
-        {
-            // Read as int
-        	int index1,index2,index3;
-        	Reader << index1;
-        	Reader << index2;
-        	Reader << index3;
-        	face.index[0] = index1 + Surface_VertexCounter;
-        	face.index[1] = index2 + Surface_VertexCounter;
-        	face.index[2] = index3 + Surface_VertexCounter;
-        }
-        allFaces.Add(face);
-    }
-    return allFaces;
+	(this->*DecodeStreams)(Reader);
+	ParseFaces(Reader);
+	BinaryReader::readList(Reader, MaterialCount, Materials);
 }
 
-TArray<C2Weight> C2MSurface::ParseWeight(FLargeMemoryReader& Reader,  uint32_t CurrentVertIndex)
+
+template <uint8_t MeshFlags>
+void C2MSurface::ParseStreams(C2MReader& Reader)
 {
-	TArray<C2Weight> C2Weights;
-	for (uint32_t i = 0; i < MaxSkinBuffer; i++)
+	using EMeshFlags = C2MeshHeader::SEModelMeshPresenceFlags;
+	constexpr bool bHasUVs = (MeshFlags & static_cast<uint8_t>(EMeshFlags::SEMODEL_PRESENCE_UVSET)) != 0;
+	constexpr bool bHasNormals = (MeshFlags & static_cast<uint8_t>(EMeshFlags::SEMODEL_PRESENCE_NORMALS)) != 0;
+	constexpr bool bHasColors = (MeshFlags & static_cast<uint8_t>(EMeshFlags::SEMODEL_PRESENCE_COLOR)) != 0;
+	constexpr bool bHasWeights = (MeshFlags & static_cast<uint8_t>(EMeshFlags::SEMODEL_PRESENCE_WEIGHTS)) != 0;
+
+	check(Arena);
+	// The file stores each attribute contiguously, so every stream is a single copy into the arena
+	const TArrayView<FVector3f> OutPositions = Arena->AllocateArray<FVector3f>(VertCount);
+	// Normals and colors are as long as the positions, only the positions and the UVs can get a count that doesn't fit
+	if (OutPositions.Num() != static_cast<int64>(VertCount))
 	{
-		C2Weight Weight;
-		if (BoneCountBuffer <= 0xFF)
-		{
-			uint8_t lc;
-			Reader << lc;
-			Weight.WeightID = lc;
-		}
-		else if (BoneCountBuffer <= 0xFFFF)
-		{
-			uint16_t lc;
-			Reader << lc;
-			Weight.WeightID = lc;
-		}
-		else
+		Reader.SetError();
+		return;
+	}
+	BinaryReader::readList(Reader, OutPositions);
+	// COD is right handed, flip Y once here instead of per vertex when building the mesh
+	C2MUtilsImport::FlipY(OutPositions);
+	Positions = OutPositions;
+	// Every material layer of the surface brings its own UV set
+	UVCount = bHasUVs ? MaterialCount : 0;
+	if constexpr (bHasUVs)
+	{
+		const TArrayView<FVector2f> OutUVs = Arena->AllocateArray<FVector2f>(static_cast<int64>(VertCount) * UVCount);
+		if (OutUVs.Num() != static_cast<int64>(VertCount) * UVCount)
 		{
-			uint32_t lc;
-			Reader << lc;
-			Weight.WeightID = lc;
+			Reader.SetError();
+			return;
 		}
-		Reader << Weight.WeightValue;
-		Weight.VertexIndex = CurrentVertIndex + Surface_VertexCounter; 
-		C2Weights.Add(Weight);
+		BinaryReader::readList(Reader, OutUVs);
+		UVs = OutUVs;
+	}
+	if constexpr (bHasNormals)
+	{
+		const TArrayView<FVector3f> OutNormals = Arena->AllocateArray<FVector3f>(VertCount);
+		BinaryReader::readList(Reader, OutNormals);
+		C2MUtilsImport::FlipY(OutNormals);
+		Normals = OutNormals;
+	}
+	if constexpr (bHasColors)
+	{
+		const TArrayView<GfxColor> OutColors = Arena->AllocateArray<GfxColor>(VertCount);
+		BinaryReader::readList(Reader, OutColors);
+		Colors = OutColors;
+	}
+	if constexpr (bHasWeights)
+	{
+		ParseWeights(Reader);
+	}
+}
+
+C2MSurface::StreamDecoder C2MSurface::GetStreamDecoder(const C2MeshHeader& Header)
+{
+	static const StreamDecoder Decoders[16] =
+	{
+		&C2MSurface::ParseStreams<0>, &C2MSurface::ParseStreams<1>, &C2MSurface::ParseStreams<2>, &C2MSurface::ParseStreams<3>,
+		&C2MSurface::ParseStreams<4>, &C2MSurface::ParseStreams<5>, &C2MSurface::ParseStreams<6>, &C2MSurface::ParseStreams<7>,
+		&C2MSurface::ParseStreams<8>, &C2MSurface::ParseStreams<9>, &C2MSurface::ParseStreams<10>, &C2MSurface::ParseStreams<11>,
+		&C2MSurface::ParseStreams<12>, &C2MSurface::ParseStreams<13>, &C2MSurface::ParseStreams<14>, &C2MSurface::ParseStreams<15>,
+	};
+	return Decoders[static_cast<uint8_t>(Header.MeshPresentFlags) & 0xF];
+}
+
+/* Decode the whole index block of a surface. IndexType is the on-disk index width */
+template <typename IndexType>
+static void DecodeFaces(C2MReader& Reader, int64 FaceCount, uint32_t BaseVertex, uint32_t* OutIndices)
+{
+	const int64 IndexCount = FaceCount * 3;
+	const TArrayView<const IndexType> Block = BinaryReader::readListView<IndexType>(Reader, IndexCount);
+	if (Block.Num() != IndexCount || IndexCount == 0)
+	{
+		FMemory::Memzero(OutIndices, IndexCount * sizeof(uint32_t));
+		return;
+	}
+	const uint8* Source = reinterpret_cast<const uint8*>(Block.GetData());
+	if constexpr (sizeof(IndexType) == 1)
+	{
+		C2MUtilsImport::WidenIndices8(Source, IndexCount, OutIndices);
 	}
-	return  C2Weights;
+	else if constexpr (sizeof(IndexType) == 2)
+	{
+		C2MUtilsImport::WidenIndices16(Source, IndexCount, OutIndices);
+	}
+	else
+	{
+		FMemory::Memcpy(OutIndices, Source, IndexCount * sizeof(uint32_t));
+	}
+	C2MUtilsImport::ReverseWindingAndOffset(OutIndices, FaceCount, BaseVertex);
 }
 
+void C2MSurface::ParseFaces(C2MReader& Reader)
+{
+	static_assert(sizeof(GfxFace) == 3 * sizeof(uint32_t), "GfxFace must be a packed index triple");
+	const TArrayView<GfxFace> OutFaces = Arena->AllocateArray<GfxFace>(FaceCount);
+	if (OutFaces.Num() != static_cast<int64>(FaceCount))
+	{
+		Reader.SetError();
+		return;
+	}
+	Faces = OutFaces;
+	uint32_t* Indices = reinterpret_cast<uint32_t*>(OutFaces.GetData());
+	if (VertCount <= 0xFF)
+	{
+		DecodeFaces<uint8_t>(Reader, FaceCount, Surface_VertexCounter, Indices);
+	}
+	else if (VertCount <= 0xFFFF)
+	{
+		DecodeFaces<uint16_t>(Reader, FaceCount, Surface_VertexCounter, Indices);
+	}
+	else
+	{
+		DecodeFaces<uint32_t>(Reader, FaceCount, Surface_VertexCounter, Indices);
+	}
+}
+
+/* Decode Count (bone id, weight) pairs straight from the mapped buffer into the flat influence arrays */
+template <typename IndexType>
+static void ReadInfluences(C2MReader& Reader, int64 Count, uint32_t* OutBoneIDs, float* OutValues)
+{
+	constexpr int64 Stride = sizeof(IndexType) + sizeof(float);
+	const TArrayView<const uint8> Block = BinaryReader::readListView<uint8>(Reader, Count * Stride);
+	if (Block.Num() != Count * Stride || Count == 0)
+	{
+		FMemory::Memzero(OutBoneIDs, Count * sizeof(uint32_t));
+		FMemory::Memzero(OutValues, Count * sizeof(float));
+		return;
+	}
+	const uint8* Source = Block.GetData();
+	for (int64 i = 0; i < Count; i++, Source += Stride)
+	{
+		OutBoneIDs[i] = BinaryReader::readUnaligned<IndexType>(Source);
+		OutValues[i] = BinaryReader::readUnaligned<float>(Source + sizeof(IndexType));
+	}
+}
+
+void C2MSurface::ParseWeights(C2MReader& Reader)
+{
+	const int64 InfluenceCount = static_cast<int64>(VertCount) * MaxSkinBuffer;
+	const TArrayView<uint32_t> OutBoneIDs = Arena->AllocateArray<uint32_t>(InfluenceCount);
+	const TArrayView<float> OutValues = Arena->AllocateArray<float>(InfluenceCount);
+	if (OutValues.Num() != InfluenceCount)
+	{
+		Reader.SetError();
+		return;
+	}
+	WeightBoneIDs = OutBoneIDs;
+	WeightValues = OutValues;
+	if (BoneCountBuffer <= 0xFF)
+	{
+		ReadInfluences<uint8_t>(Reader, InfluenceCount, OutBoneIDs.GetData(), OutValues.GetData());
+	}
+	else if (BoneCountBuffer <= 0xFFFF)
+	{
+		ReadInfluences<uint16_t>(Reader, InfluenceCount, OutBoneIDs.GetData(), OutValues.GetData());
+	}
+	else
+	{
+		ReadInfluences<uint32_t>(Reader, InfluenceCount, OutBoneIDs.GetData(), OutValues.GetData());
+	}
+}
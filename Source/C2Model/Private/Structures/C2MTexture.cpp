@@ -7,7 +7,7 @@ C2MTexture::C2MTexture()
 	TexturePath = "";
 }
 
-void C2MTexture::ParseTexture(FLargeMemoryReader& Reader)
+void C2MTexture::ParseTexture(C2MReader& Reader)
 {
 	BinaryReader::readString(Reader, &TextureName);
 	//TextureName = TextureName.Replace(TEXT("~"),TEXT("_")).Replace(TEXT("$"),TEXT("_")); // UE Does not like those signs :D
@@ -4,10 +4,10 @@
 
 
 C2Material::C2Material()
+	: Header(MakeUnique<C2MaterialHeader>())
 {
-	Header = new C2MaterialHeader();
 }
-void C2Material::ParseMaterial(FLargeMemoryReader& Reader)
+void C2Material::ParseMaterial(C2MReader& Reader)
 {
 	Header->ParseHeader(Reader);
 	Textures.Reserve(Header->TextureCount);
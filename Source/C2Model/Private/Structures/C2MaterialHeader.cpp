@@ -10,7 +10,7 @@ C2MaterialHeader::C2MaterialHeader()
 }
 C2MaterialHeader::~C2MaterialHeader(){}
 
-void C2MaterialHeader::ParseHeader(FLargeMemoryReader& Reader)
+void C2MaterialHeader::ParseHeader(C2MReader& Reader)
 {
 	BinaryReader::readString(Reader, &MaterialName);
 	Reader.ByteOrderSerialize(&Blending, 1);
@@ -1,8 +1,68 @@
 ﻿#include "Structures/C2Mesh.h"
 #include "Structures/C2Material.h"
-void C2Mesh::ParseMesh(FLargeMemoryReader& Reader)
+#include "Async/ParallelFor.h"
+
+/* Quaternions are stored as 4 packed floats (X, Y, Z, W) */
+static FQuat4f ReadQuat(const uint8* Source)
+{
+	float Components[4];
+	FMemory::Memcpy(Components, Source, sizeof(Components));
+	return FQuat4f(Components[0], Components[1], Components[2], Components[3]);
+}
+
+/* Every bone record has the same layout: flags, parent, then whichever transforms the header says are present */
+static int64 GetBoneStride(const C2MeshHeader& Header)
+{
+	using EBoneFlags = C2MeshHeader::SEModelBonePresenceFlags;
+	constexpr int64 TransformSize = sizeof(FVector3f) + 4 * sizeof(float);
+	return sizeof(uint8) + sizeof(uint32_t)
+		+ (Header.HasBoneData(EBoneFlags::SEMODEL_PRESENCE_GLOBAL_MATRIX) ? TransformSize : 0)
+		+ (Header.HasBoneData(EBoneFlags::SEMODEL_PRESENCE_LOCAL_MATRIX) ? TransformSize : 0)
+		+ (Header.HasBoneData(EBoneFlags::SEMODEL_PRESENCE_SCALES) ? sizeof(FVector3f) : 0);
+}
+
+bool C2Mesh::Probe(C2MReader& Reader, C2MeshProbe& OutProbe)
+{
+	C2MeshHeader& Header = OutProbe.Header;
+	Header.ParseHeader(Reader);
+	// Every name takes at least its terminator, a corrupt count can't reserve more than the file holds
+	OutProbe.BoneNames.Reset(FMath::Min<int64>(Header.BoneCountBuffer, Reader.GetRemaining()));
+	for (uint32_t BoneIndex = 0; BoneIndex < Header.BoneCountBuffer && !Reader.IsError(); BoneIndex++)
+	{
+		BinaryReader::readString(Reader, &OutProbe.BoneNames.AddDefaulted_GetRef());
+	}
+	// Bone records and surface bodies have a fixed size once their headers are known, only the headers are touched
+	Reader.Skip(Header.BoneCountBuffer * GetBoneStride(Header));
+	OutProbe.VertexCount = 0;
+	OutProbe.FaceCount = 0;
+	for (uint32_t SurfaceIndex = 0; SurfaceIndex < Header.SurfaceCount && !Reader.IsError(); SurfaceIndex++)
+	{
+		C2MSurface Surface;
+		Surface.ParseSurfaceHeader(Reader, Header.BoneCountBuffer, SurfaceIndex, OutProbe.VertexCount);
+		if (!Reader.Skip(Surface.GetBodySize(Header)))
+		{
+			break;
+		}
+		OutProbe.VertexCount += Surface.VertCount;
+		OutProbe.FaceCount += Surface.FaceCount;
+	}
+	return !Reader.IsError();
+}
+
+C2Mesh::C2Mesh()
+	: OwnedArena(MakeUnique<C2MArena>())
+	, Arena(OwnedArena.Get())
+{
+}
+
+C2Mesh::C2Mesh(C2MArena& InArena)
+	: Arena(&InArena)
 {
-	Header = new C2MeshHeader();
+}
+
+void C2Mesh::ParseMesh(C2MReader& Reader)
+{
+	Header = Arena->New<C2MeshHeader>();
 	Header->ParseHeader(Reader);
 	
 	Surfaces.Reserve(Header->SurfaceCount);
@@ -14,28 +74,79 @@ void C2Mesh::ParseMesh(FLargeMemoryReader& Reader)
 		BinaryReader::readString(Reader, &Bone.Name);
 		Bones.Add(Bone);
 	}
-	for (size_t BoneIndex = 0; BoneIndex < Header->BoneCountBuffer; BoneIndex++)
+	using EBoneFlags = C2MeshHeader::SEModelBonePresenceFlags;
+	const bool bHasGlobalMatrix = Header->HasBoneData(EBoneFlags::SEMODEL_PRESENCE_GLOBAL_MATRIX);
+	const bool bHasLocalMatrix = Header->HasBoneData(EBoneFlags::SEMODEL_PRESENCE_LOCAL_MATRIX);
+	const bool bHasScales = Header->HasBoneData(EBoneFlags::SEMODEL_PRESENCE_SCALES);
+	// Every bone record has the same layout, so the whole block is viewed at once and decoded in place
+	constexpr int64 TransformSize = sizeof(FVector3f) + 4 * sizeof(float);
+	const int64 BoneStride = GetBoneStride(*Header);
+	const int64 BoneBlockSize = Header->BoneCountBuffer * BoneStride;
+	const TArrayView<const uint8> BoneBlock = BinaryReader::readListView<uint8>(Reader, BoneBlockSize);
+	for (int32 BoneIndex = 0; BoneIndex < Bones.Num() && BoneBlock.Num() == BoneBlockSize; BoneIndex++)
 	{
 		C2Bone& Bone = Bones[BoneIndex];
-		Reader << Bone.non;
-		Reader << Bone.ParentIndex;
-		Reader << Bone.GlobalPosition;
-		FQuat4f GlobalRotationQuat;
-		Reader << GlobalRotationQuat;
-		Bone.GlobalRotation = GlobalRotationQuat.Rotator();
-		Reader << Bone.LocalPosition;
-		FQuat4f LocalRotationQuat;
-		Reader << LocalRotationQuat;
-		Bone.LocalRotation = LocalRotationQuat.Rotator();
+		const uint8* Record = BoneBlock.GetData() + BoneIndex * BoneStride;
+		Bone.non = Record[0];
+		Bone.ParentIndex = BinaryReader::readUnaligned<uint32_t>(Record + 1);
+		Record += sizeof(uint8) + sizeof(uint32_t);
+		if (bHasGlobalMatrix)
+		{
+			Bone.GlobalPosition = BinaryReader::readUnaligned<FVector3f>(Record);
+			Bone.GlobalRotation = ReadQuat(Record + sizeof(FVector3f));
+			Record += TransformSize;
+		}
+		if (bHasLocalMatrix)
+		{
+			Bone.LocalPosition = BinaryReader::readUnaligned<FVector3f>(Record);
+			Bone.LocalRotation = ReadQuat(Record + sizeof(FVector3f));
+			Record += TransformSize;
+		}
+		if (bHasScales)
+		{
+			Bone.Scale = BinaryReader::readUnaligned<FVector3f>(Record);
+		}
 	}
 	// Used to keep track of verts between surfaces because they are binded to the surface and unreal doesnt know that
 	surf_vertCounter = 0;
+	UVSetCount = 1;
+	// Pre-scan: surface sizes only depend on their headers, so read those first and skip over the bodies
+	TArray<int64> BodyOffsets;
+	TArray<int64> BodySizes;
+	BodyOffsets.Reserve(Header->SurfaceCount);
+	BodySizes.Reserve(Header->SurfaceCount);
+	int64 DecodedSize = 0;
 	for (uint32_t SurfaceIndex = 0; SurfaceIndex < Header->SurfaceCount; SurfaceIndex++)
 	{
-		C2MSurface* Surface = new C2MSurface();
-		Surface->ParseSurface(Reader, Header->BoneCountBuffer, SurfaceIndex, surf_vertCounter);
+		C2MSurface* Surface = Arena->New<C2MSurface>();
+		Surface->Arena = Arena;
+		Surface->ParseSurfaceHeader(Reader, Header->BoneCountBuffer, SurfaceIndex, surf_vertCounter);
+		const int64 BodySize = Surface->GetBodySize(*Header);
+		BodyOffsets.Add(Reader.Tell());
+		BodySizes.Add(BodySize);
+		if (!Reader.Skip(BodySize))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Surface %u of '%s' runs past the end of the file"), SurfaceIndex, *Reader.GetArchiveName());
+			break;
+		}
 		Surfaces.Push(Surface);
-		surf_vertCounter += Surface->Vertexes.Num();
+		surf_vertCounter += Surface->VertCount;
+		DecodedSize += Surface->GetDecodedSize(*Header);
+	}
+	// All stream sizes are known now, grab them in one block so the parallel decode never grows the arena
+	Arena->Reserve(DecodedSize);
+
+	// Surfaces share nothing once their offsets and vertex bases are known, decode them all at once
+	const C2MSurface::StreamDecoder DecodeStreams = C2MSurface::GetStreamDecoder(*Header);
+	ParallelFor(Surfaces.Num(), [&](int32 SurfaceIndex)
+	{
+		C2MReader SurfaceReader(Reader.GetData() + BodyOffsets[SurfaceIndex], BodySizes[SurfaceIndex], Reader.GetArchiveName());
+		Surfaces[SurfaceIndex]->ParseSurfaceBody(SurfaceReader, DecodeStreams);
+	}, EParallelForFlags::Unbalanced);
+
+	for (const C2MSurface* Surface : Surfaces)
+	{
+		UVSetCount = FMath::Max(UVSetCount, Surface->UVCount);
 	}
 
 	for (size_t MaterialIndex = 0; MaterialIndex < Header->MaterialCountBuffer; MaterialIndex++)
@@ -54,7 +165,5 @@ void C2Mesh::ParseMesh(FLargeMemoryReader& Reader)
 		}
 		Materials.Add(Material);
 	}
-	Reader.Close();
-	
 }
 
@@ -5,6 +5,8 @@
 C2MeshHeader::C2MeshHeader()
 {
 	DataPresentFlags = SEModelDataPresenceFlags::SEMODEL_PRESENCE_MESH;
+	BonePresentFlags = static_cast<SEModelBonePresenceFlags>(0);
+	MeshPresentFlags = static_cast<SEModelMeshPresenceFlags>(0);
 	GameName = "";
 	MeshName = "";
 	BoneCountBuffer = 0;
@@ -14,13 +16,15 @@ C2MeshHeader::C2MeshHeader()
 C2MeshHeader::C2MeshHeader(FString InName)
 {
 	DataPresentFlags = SEModelDataPresenceFlags::SEMODEL_PRESENCE_MESH;
+	BonePresentFlags = static_cast<SEModelBonePresenceFlags>(0);
+	MeshPresentFlags = static_cast<SEModelMeshPresenceFlags>(0);
 	GameName = "";
 	MeshName = InName;
 	BoneCountBuffer = 0;
 	SurfaceCount = 1;
 	MaterialCountBuffer = 0;
 }
-void C2MeshHeader::ParseHeader(FLargeMemoryReader& Reader)
+void C2MeshHeader::ParseHeader(C2MReader& Reader)
 {
 	Reader.ByteOrderSerialize(&Magic, sizeof(Magic));
 	uint16_t Version;
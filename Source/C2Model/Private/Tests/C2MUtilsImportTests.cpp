@@ -0,0 +1,70 @@
+﻿#include "Misc/AutomationTest.h"
+#include "Math/RandomStream.h"
+#include "Utils/C2MUtilsImport.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FC2MFlipRotationsYTest, "C2Model.Utils.FlipRotationsY",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace
+{
+	// Handedness flip as the importers did it before FlipRotationsY: negate yaw and roll on the rotator
+	FQuat4f FlipThroughRotator(const FQuat4f& Rotation)
+	{
+		FRotator3f Rotator = Rotation.GetNormalized().Rotator();
+		Rotator.Yaw *= -1.0f;
+		Rotator.Roll *= -1.0f;
+		return Rotator.Quaternion();
+	}
+
+	// q and -q describe the same rotation
+	bool EqualsUpToSign(const FQuat4f& A, const FQuat4f& B, float Tolerance)
+	{
+		return A.Equals(B, Tolerance) || A.Equals(B * -1.0f, Tolerance);
+	}
+}
+
+bool FC2MFlipRotationsYTest::RunTest(const FString& Parameters)
+{
+	TArray<FQuat4f> Rotations;
+	Rotations.Add(FQuat4f::Identity);
+
+	FRandomStream Random(0xC2);
+	for (int32 i = 0; i < 256; i++)
+	{
+		const FVector3f Axis = FVector3f(Random.GetUnitVector());
+		Rotations.Add(FQuat4f(Axis, Random.FRandRange(-PI, PI)));
+	}
+
+	// Pitch at and around +-90 is where the rotator path hits gimbal lock
+	for (const float Pitch : { -90.0f, -89.9f, 89.9f, 90.0f })
+	{
+		for (int32 i = 0; i < 8; i++)
+		{
+			Rotations.Add(FRotator3f(Pitch, Random.FRandRange(-180.0f, 180.0f), Random.FRandRange(-180.0f, 180.0f)).Quaternion());
+		}
+	}
+
+	TArray<FQuat4f> Flipped = Rotations;
+	C2MUtilsImport::FlipRotationsY(Flipped);
+	for (int32 i = 0; i < Rotations.Num(); i++)
+	{
+		const FQuat4f Expected = FlipThroughRotator(Rotations[i]);
+		if (!EqualsUpToSign(Flipped[i], Expected, 1.e-3f))
+		{
+			AddError(FString::Printf(TEXT("Rotation %d: %s flipped to %s, expected %s"), i,
+				*Rotations[i].ToString(), *Flipped[i].ToString(), *Expected.ToString()));
+		}
+		TestTrue(TEXT("Kernel matches the scalar flip"), Flipped[i].Equals(C2MUtilsImport::FlipRotationY(Rotations[i]), 0.0f));
+	}
+
+	// The rotator path normalizes a zero quaternion to identity, the kernel has to leave it zero
+	TArray<FQuat4f> Zero = { FQuat4f(0.0f, 0.0f, 0.0f, 0.0f) };
+	C2MUtilsImport::FlipRotationsY(Zero);
+	TestTrue(TEXT("Zero quaternion stays zero"), Zero[0].Equals(FQuat4f(0.0f, 0.0f, 0.0f, 0.0f), 0.0f));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -1,28 +1,44 @@
 ﻿#include "Utils/BinaryReader.h"
 
-void BinaryReader::readString(FArchive& Ar, FString* outText)
+#include <cstring>
+
+/* Find the '\x00' terminating the string at the cursor, returns its length or -1 if the buffer ends first */
+static int64 FindStringLength(const C2MReader& Ar)
 {
-	//Ar.Seek(Ar.Tell() + 1);
-	char c;
-	// Start reading characters until we hit '\x00'
-	while(Ar << c, c != 0)
+	if (Ar.IsError() || Ar.GetRemaining() <= 0)
 	{
-	    *outText += c;
+		return -1;
 	}
-	int bk = 3;
+	const uint8* Start = Ar.GetCursor();
+	const uint8* Terminator = static_cast<const uint8*>(memchr(Start, 0, Ar.GetRemaining()));
+	return Terminator ? Terminator - Start : -1;
 }
 
-template <typename T>
-TArray<T> BinaryReader::readList(FArchive& Ar, uint32_t count)
+void BinaryReader::readString(C2MReader& Ar, FString* outText)
 {
-	TArray<T> arr;
-	T vec;
-	arr.Reserve(count);
-	for (uint32_t x = 0; x < count; x++)
+	const int64 Length = FindStringLength(Ar);
+	if (Length < 0)
+	{
+		// Unterminated string, flag the archive instead of reading past the end
+		Ar.Skip(Ar.GetRemaining() + 1);
+		return;
+	}
+	if (Length > 0)
 	{
-		Ar.ByteOrderSerialize(&vec, sizeof(vec));;
-		arr.Push(vec);
+		outText->AppendChars(reinterpret_cast<const ANSICHAR*>(Ar.GetCursor()), static_cast<int32>(Length));
 	}
+	Ar.Skip(Length + 1);
+}
 
-	return arr;
-}
\ No newline at end of file
+FName BinaryReader::readName(C2MReader& Ar)
+{
+	const int64 Length = FindStringLength(Ar);
+	if (Length < 0)
+	{
+		Ar.Skip(Ar.GetRemaining() + 1);
+		return NAME_None;
+	}
+	const FName Name(static_cast<int32>(Length), reinterpret_cast<const ANSICHAR*>(Ar.GetCursor()));
+	Ar.Skip(Length + 1);
+	return Name;
+}
@@ -0,0 +1,109 @@
+﻿#include "Utils/C2MArena.h"
+
+#include "Misc/ScopeLock.h"
+
+// Blocks are cache line aligned so any element alignment up to that is served by offsetting
+static constexpr int64 BlockAlignment = 64;
+static constexpr int64 MinBlockSize = 1024 * 1024;
+
+C2MArena::C2MArena()
+	: UsedBytes(0)
+	, PeakBytes(0)
+	, ReservedBytes(0)
+{
+}
+
+C2MArena::~C2MArena()
+{
+	Reset();
+	for (const FBlock& Block : Blocks)
+	{
+		FMemory::Free(Block.Data);
+	}
+}
+
+void* C2MArena::Allocate(int64 Size, int64 Alignment)
+{
+	check(Alignment > 0 && Alignment <= BlockAlignment && FMath::IsPowerOfTwo(Alignment));
+	FScopeLock ScopeLock(&Lock);
+	if (Blocks.Num() == 0 || Align(Blocks.Last().Used, Alignment) + Size > Blocks.Last().Size)
+	{
+		AddBlock(Size);
+	}
+	FBlock& Block = Blocks.Last();
+	const int64 Start = Align(Block.Used, Alignment);
+	Block.Used = Start + Size;
+	UsedBytes += Size;
+	PeakBytes = FMath::Max(PeakBytes, UsedBytes);
+	return Block.Data + Start;
+}
+
+void C2MArena::Reserve(int64 Size)
+{
+	FScopeLock ScopeLock(&Lock);
+	if (Blocks.Num() == 0 || Blocks.Last().Used + Size > Blocks.Last().Size)
+	{
+		AddBlock(Size);
+	}
+}
+
+void C2MArena::AddBlock(int64 MinSize)
+{
+	// Grow geometrically so a parse that wasn't reserved up front still only touches a handful of blocks
+	const int64 LastSize = Blocks.Num() > 0 ? Blocks.Last().Size : 0;
+	const int64 BlockSize = Align(FMath::Max3(MinSize, LastSize * 2, MinBlockSize), BlockAlignment);
+	FBlock& Block = Blocks.AddDefaulted_GetRef();
+	Block.Data = static_cast<uint8*>(FMemory::Malloc(BlockSize, BlockAlignment));
+	Block.Size = BlockSize;
+	Block.Used = 0;
+	ReservedBytes += BlockSize;
+}
+
+void C2MArena::AddDestructor(void* Object, void (*Destroy)(void*))
+{
+	FScopeLock ScopeLock(&Lock);
+	Destructors.Add({ Object, Destroy });
+}
+
+void C2MArena::Reset()
+{
+	FScopeLock ScopeLock(&Lock);
+	// Objects can point at each other, tear them down in reverse order of creation
+	for (int32 i = Destructors.Num() - 1; i >= 0; i--)
+	{
+		Destructors[i].Destroy(Destructors[i].Object);
+	}
+	Destructors.Reset();
+
+	int32 Largest = INDEX_NONE;
+	for (int32 i = 0; i < Blocks.Num(); i++)
+	{
+		if (Largest == INDEX_NONE || Blocks[i].Size > Blocks[Largest].Size)
+		{
+			Largest = i;
+		}
+	}
+	for (int32 i = 0; i < Blocks.Num(); i++)
+	{
+		if (i != Largest)
+		{
+			FMemory::Free(Blocks[i].Data);
+		}
+	}
+	if (Largest != INDEX_NONE)
+	{
+		const FBlock Kept = { Blocks[Largest].Data, Blocks[Largest].Size, 0 };
+		Blocks.Reset();
+		Blocks.Add(Kept);
+		ReservedBytes = Kept.Size;
+	}
+	// Peak is per use of the arena (one imported file), not over the whole batch
+	UsedBytes = 0;
+	PeakBytes = 0;
+}
+
+void C2MArena::LogUsage(const FString& Context) const
+{
+	UE_LOG(LogTemp, Log, TEXT("%s: parse memory peak %.2f MB, retained %.2f MB"), *Context,
+		PeakBytes / (1024.0 * 1024.0), ReservedBytes / (1024.0 * 1024.0));
+}
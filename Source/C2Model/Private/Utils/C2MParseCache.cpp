@@ -0,0 +1,448 @@
+﻿#include "Utils/C2MParseCache.h"
+
+#include "Structures/C2Mesh.h"
+#include "Structures/C2Anim.h"
+#include "Utils/BinaryReader.h"
+#include "Hash/xxhash.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Guid.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryWriter.h"
+
+static TAutoConsoleVariable<bool> CVarParseCache(
+	TEXT("C2M.ParseCache"),
+	false,
+	TEXT("Cache decoded SEModel/SEAnim files in Saved/C2Model/ParseCache so re-imports of unchanged exports skip parsing"));
+
+static TAutoConsoleVariable<int32> CVarParseCacheMaxSizeMB(
+	TEXT("C2M.ParseCache.MaxSizeMB"),
+	2048,
+	TEXT("Size budget of the parse cache, least recently used entries are evicted past it"));
+
+// "C2MC"
+static constexpr uint32 CacheMagic = 0x434D3243;
+// Entries are mapped from a page boundary, so aligning offsets inside the file aligns the mapped streams
+static constexpr int64 StreamAlignment = 16;
+
+int32 C2MParseCache::Hits = 0;
+int32 C2MParseCache::Misses = 0;
+int32 C2MParseCache::Evictions = 0;
+int64 C2MParseCache::CacheSize = INDEX_NONE;
+
+/* Streams are written as a count followed by the raw elements on an aligned offset */
+template <typename T>
+static void SerializeStream(FArchive& Ar, TArrayView<const T>& Stream)
+{
+	static const uint8 Padding[StreamAlignment] = {};
+	int32 Num = Stream.Num();
+	Ar << Num;
+	const int64 PaddingSize = Align(Ar.Tell(), StreamAlignment) - Ar.Tell();
+	if (Ar.IsLoading())
+	{
+		// Entries are only ever loaded through a mapped C2MReader, point the stream straight at it
+		C2MReader& Reader = static_cast<C2MReader&>(Ar);
+		Reader.Skip(PaddingSize);
+		Stream = BinaryReader::readListView<T>(Reader, Num);
+		if (Stream.Num() != Num)
+		{
+			Reader.SetError();
+		}
+	}
+	else
+	{
+		Ar.Serialize(const_cast<uint8*>(Padding), PaddingSize);
+		Ar.Serialize(const_cast<T*>(Stream.GetData()), static_cast<int64>(Num) * sizeof(T));
+	}
+}
+
+/* Track arrays are copied in and out whole, keys are plain data */
+template <typename T>
+static void SerializeTrack(FArchive& Ar, TArray<T>& Track)
+{
+	static_assert(std::is_trivially_copyable_v<T>, "Tracks are stored as raw bytes");
+	int32 Num = Track.Num();
+	Ar << Num;
+	if (Ar.IsLoading())
+	{
+		if (Ar.IsError() || Num < 0 || static_cast<int64>(Num) * sizeof(T) > Ar.TotalSize() - Ar.Tell())
+		{
+			Ar.SetError();
+			return;
+		}
+		Track.SetNumUninitialized(Num);
+	}
+	Ar.Serialize(Track.GetData(), static_cast<int64>(Num) * sizeof(T));
+}
+
+static void SerializeMesh(FArchive& Ar, C2Mesh& Mesh, C2MArena& Arena)
+{
+	C2MeshHeader& Header = *Mesh.Header;
+	Ar.Serialize(Header.Magic, sizeof(Header.Magic));
+	Ar << Header.DataPresentFlags;
+	Ar << Header.BonePresentFlags;
+	Ar << Header.MeshPresentFlags;
+	Ar << Header.GameName;
+	Ar << Header.MeshName;
+	Ar << Header.BoneCountBuffer;
+	Ar << Header.SurfaceCount;
+	Ar << Header.MaterialCountBuffer;
+	Ar << Mesh.bIsXModel;
+	Ar << Mesh.surf_vertCounter;
+	Ar << Mesh.UVSetCount;
+
+	int32 BoneCount = Mesh.Bones.Num();
+	Ar << BoneCount;
+	if (Ar.IsLoading())
+	{
+		if (Ar.IsError() || BoneCount < 0 || BoneCount > static_cast<int32>(Header.BoneCountBuffer))
+		{
+			Ar.SetError();
+			return;
+		}
+		Mesh.Bones.SetNum(BoneCount);
+	}
+	for (C2Bone& Bone : Mesh.Bones)
+	{
+		Ar << Bone.Name;
+		Ar << Bone.non;
+		Ar << Bone.ParentIndex;
+		Ar << Bone.GlobalPosition;
+		Ar << Bone.GlobalRotation;
+		Ar << Bone.LocalPosition;
+		Ar << Bone.LocalRotation;
+		Ar << Bone.Scale;
+	}
+
+	int32 SurfaceCount = Mesh.Surfaces.Num();
+	Ar << SurfaceCount;
+	if (Ar.IsLoading())
+	{
+		if (Ar.IsError() || SurfaceCount < 0 || SurfaceCount > static_cast<int32>(Header.SurfaceCount))
+		{
+			Ar.SetError();
+			return;
+		}
+		Mesh.Surfaces.Reset(SurfaceCount);
+		for (int32 SurfaceIndex = 0; SurfaceIndex < SurfaceCount; SurfaceIndex++)
+		{
+			C2MSurface* Surface = Arena.New<C2MSurface>();
+			Surface->Arena = &Arena;
+			Mesh.Surfaces.Add(Surface);
+		}
+	}
+	for (C2MSurface* Surface : Mesh.Surfaces)
+	{
+		Ar << Surface->Name;
+		Ar << Surface->Materials;
+		Ar << Surface->UVCount;
+		Ar << Surface->Surface_VertexCounter;
+		Ar << Surface->BoneCountBuffer;
+		Ar << Surface->Empty;
+		Ar << Surface->MaterialCount;
+		Ar << Surface->FaceCount;
+		Ar << Surface->VertCount;
+		Ar << Surface->MaxSkinBuffer;
+		SerializeStream(Ar, Surface->Positions);
+		SerializeStream(Ar, Surface->UVs);
+		SerializeStream(Ar, Surface->Normals);
+		SerializeStream(Ar, Surface->Colors);
+		SerializeStream(Ar, Surface->WeightBoneIDs);
+		SerializeStream(Ar, Surface->WeightValues);
+		SerializeStream(Ar, Surface->Faces);
+	}
+
+	int32 MaterialCount = Mesh.Materials.Num();
+	Ar << MaterialCount;
+	if (Ar.IsLoading())
+	{
+		if (Ar.IsError() || MaterialCount < 0 || MaterialCount > static_cast<int32>(Header.MaterialCountBuffer))
+		{
+			Ar.SetError();
+			return;
+		}
+		Mesh.Materials.SetNum(MaterialCount);
+	}
+	for (C2ModelMaterial& Material : Mesh.Materials)
+	{
+		Ar << Material.MaterialName;
+		Ar << Material.TextureNames;
+		Ar << Material.TextureTypes;
+	}
+}
+
+static void SerializeAnim(FArchive& Ar, C2Anim& Anim)
+{
+	Ar.Serialize(&Anim.Header, sizeof(Anim.Header));
+
+	int32 BoneCount = Anim.BonesInfos.Num();
+	Ar << BoneCount;
+	if (Ar.IsLoading())
+	{
+		if (Ar.IsError() || BoneCount < 0 || BoneCount > static_cast<int32>(Anim.Header.BoneCountBuffer))
+		{
+			Ar.SetError();
+			return;
+		}
+		Anim.BonesInfos.SetNum(BoneCount);
+	}
+	for (BoneInfo& Info : Anim.BonesInfos)
+	{
+		// FNames aren't portable through a plain archive, go through the string
+		FString Name = Info.Name.ToString();
+		Ar << Name;
+		Info.Name = FName(*Name);
+		Ar << Info.index;
+		SerializeTrack(Ar, Info.BonePositions.Frames);
+		SerializeTrack(Ar, Info.BonePositions.Values);
+		SerializeTrack(Ar, Info.BoneRotations.Frames);
+		SerializeTrack(Ar, Info.BoneRotations.Values);
+		SerializeTrack(Ar, Info.BoneScale.Frames);
+		SerializeTrack(Ar, Info.BoneScale.Values);
+	}
+}
+
+bool C2MParseCache::IsEnabled()
+{
+	return CVarParseCache.GetValueOnAnyThread();
+}
+
+FString C2MParseCache::GetCacheDir()
+{
+	return FPaths::ProjectSavedDir() / TEXT("C2Model") / TEXT("ParseCache");
+}
+
+FString C2MParseCache::GetEntryPath(uint64 Hash, const TCHAR* Extension)
+{
+	return GetCacheDir() / FString::Printf(TEXT("%016llx_v%u.%s"), Hash, ParserVersion, Extension);
+}
+
+uint64 C2MParseCache::HashSource(C2MReader& Source)
+{
+	return FXxHash64::HashBuffer(Source.GetData(), Source.TotalSize()).Hash;
+}
+
+C2MFileReader* C2MParseCache::OpenEntry(const FString& Path, uint64 Hash, int64 SourceSize, C2MArena& Arena)
+{
+	IFileManager& FileManager = IFileManager::Get();
+	if (!FileManager.FileExists(*Path))
+	{
+		return nullptr;
+	}
+	// Touch it first so eviction sees it as recently used, some platforms refuse while the file is mapped
+	FileManager.SetTimeStamp(*Path, FDateTime::UtcNow());
+
+	// The entry lives in the arena so the mapping outlives the views handed to the surfaces
+	C2MFileReader* Entry = Arena.New<C2MFileReader>();
+	if (!Entry->Open(Path))
+	{
+		return nullptr;
+	}
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	uint64 EntryHash = 0;
+	int64 EntrySourceSize = 0;
+	*Entry << Magic;
+	*Entry << Version;
+	*Entry << EntryHash;
+	*Entry << EntrySourceSize;
+	if (Entry->IsError() || Magic != CacheMagic || Version != ParserVersion || EntryHash != Hash || EntrySourceSize != SourceSize)
+	{
+		Entry->Close();
+		return nullptr;
+	}
+	return Entry;
+}
+
+void C2MParseCache::WriteEntryHeader(FArchive& Writer, uint64 Hash, int64 SourceSize)
+{
+	uint32 Magic = CacheMagic;
+	uint32 Version = ParserVersion;
+	Writer << Magic;
+	Writer << Version;
+	Writer << Hash;
+	Writer << SourceSize;
+}
+
+void C2MParseCache::WriteEntry(const FString& Path, const TArray<uint8>& Payload)
+{
+	// Write next to the entry and move it in place, a half written file must never look like a valid entry.
+	// LODs are parsed concurrently and identical files share an entry, so every write stages to its own file
+	IFileManager& FileManager = IFileManager::Get();
+	const FString TempPath = FString::Printf(TEXT("%s.%s.tmp"), *Path, *FGuid::NewGuid().ToString());
+	if (!FFileHelper::SaveArrayToFile(Payload, *TempPath))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not write parse cache entry '%s'"), *Path);
+		FileManager.Delete(*TempPath, false, false, true);
+		return;
+	}
+	if (!FileManager.Move(*Path, *TempPath))
+	{
+		// Another writer got the same entry in first (and may have it mapped already), its copy is just as good
+		if (!FileManager.FileExists(*Path))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Could not write parse cache entry '%s'"), *Path);
+		}
+		FileManager.Delete(*TempPath, false, false, true);
+		return;
+	}
+	Evict(Payload.Num());
+}
+
+void C2MParseCache::Evict(int64 AddedBytes)
+{
+	// LODs are parsed concurrently, only one of them trims the directory at a time
+	static FCriticalSection EvictLock;
+	FScopeLock ScopeLock(&EvictLock);
+	const int64 Budget = static_cast<int64>(FMath::Max(CVarParseCacheMaxSizeMB.GetValueOnAnyThread(), 0)) * 1024 * 1024;
+	// The running total is seeded by the first scan. Replaced or discarded entries can make it run high, which only
+	// means the directory is scanned a little early, the scan then sets it to the real size
+	if (CacheSize != INDEX_NONE)
+	{
+		CacheSize += AddedBytes;
+		if (CacheSize <= Budget)
+		{
+			return;
+		}
+	}
+	struct FEntryInfo
+	{
+		FString Path;
+		int64 Size;
+		FDateTime LastUsed;
+	};
+	IFileManager& FileManager = IFileManager::Get();
+	const FString CacheDir = GetCacheDir();
+	TArray<FString> FileNames;
+	FileManager.FindFiles(FileNames, *(CacheDir / TEXT("*")), true, false);
+
+	TArray<FEntryInfo> Entries;
+	int64 TotalSize = 0;
+	for (const FString& FileName : FileNames)
+	{
+		const FString Extension = FPaths::GetExtension(FileName);
+		if (Extension != TEXT("c2mesh") && Extension != TEXT("c2anim"))
+		{
+			continue;
+		}
+		FEntryInfo& Info = Entries.AddDefaulted_GetRef();
+		Info.Path = CacheDir / FileName;
+		Info.Size = FileManager.FileSize(*Info.Path);
+		Info.LastUsed = FileManager.GetTimeStamp(*Info.Path);
+		TotalSize += Info.Size;
+	}
+
+	CacheSize = TotalSize;
+	if (TotalSize <= Budget)
+	{
+		return;
+	}
+	Entries.Sort([](const FEntryInfo& A, const FEntryInfo& B) { return A.LastUsed < B.LastUsed; });
+	for (const FEntryInfo& Info : Entries)
+	{
+		if (TotalSize <= Budget)
+		{
+			break;
+		}
+		if (FileManager.Delete(*Info.Path, false, false, true))
+		{
+			TotalSize -= Info.Size;
+			FPlatformAtomics::InterlockedIncrement(&Evictions);
+		}
+	}
+	CacheSize = TotalSize;
+	UE_LOG(LogTemp, Log, TEXT("Parse cache trimmed to %.2f MB (%d entries evicted so far)"), TotalSize / (1024.0 * 1024.0), Evictions);
+}
+
+void C2MParseCache::CountLookup(bool bHit, const FString& SourceName)
+{
+	if (bHit)
+	{
+		FPlatformAtomics::InterlockedIncrement(&Hits);
+	}
+	else
+	{
+		FPlatformAtomics::InterlockedIncrement(&Misses);
+	}
+	UE_LOG(LogTemp, Log, TEXT("Parse cache %s for '%s' (%d hits, %d misses)"), bHit ? TEXT("hit") : TEXT("miss"), *SourceName, Hits, Misses);
+}
+
+void C2MParseCache::ParseMesh(C2MReader& Source, C2Mesh& Mesh, C2MArena& Arena)
+{
+	if (!IsEnabled())
+	{
+		Mesh.ParseMesh(Source);
+		return;
+	}
+	const uint64 Hash = HashSource(Source);
+	const int64 SourceSize = Source.TotalSize();
+	const FString Path = GetEntryPath(Hash, TEXT("c2mesh"));
+	if (C2MFileReader* Entry = OpenEntry(Path, Hash, SourceSize, Arena))
+	{
+		Mesh.Header = Arena.New<C2MeshHeader>();
+		SerializeMesh(*Entry, Mesh, Arena);
+		if (!Entry->IsError())
+		{
+			CountLookup(true, Source.GetArchiveName());
+			return;
+		}
+		// Damaged entry, drop it and fall back to the source
+		UE_LOG(LogTemp, Warning, TEXT("Discarding damaged parse cache entry '%s'"), *Path);
+		Mesh.Bones.Reset();
+		Mesh.Surfaces.Reset();
+		Mesh.Materials.Reset();
+		Entry->Close();
+		IFileManager::Get().Delete(*Path, false, false, true);
+	}
+	CountLookup(false, Source.GetArchiveName());
+	Mesh.ParseMesh(Source);
+	if (Source.IsError())
+	{
+		return;
+	}
+	TArray<uint8> Payload;
+	FMemoryWriter Writer(Payload);
+	WriteEntryHeader(Writer, Hash, SourceSize);
+	SerializeMesh(Writer, Mesh, Arena);
+	WriteEntry(Path, Payload);
+}
+
+void C2MParseCache::ParseAnim(C2MReader& Source, C2Anim& Anim, C2MArena& Arena)
+{
+	// A slice is keyed on the requested range as well as the file, it isn't worth an entry of its own
+	if (!IsEnabled() || Anim.HasFrameRange())
+	{
+		Anim.ParseAnim(Source);
+		return;
+	}
+	const uint64 Hash = HashSource(Source);
+	const int64 SourceSize = Source.TotalSize();
+	const FString Path = GetEntryPath(Hash, TEXT("c2anim"));
+	if (C2MFileReader* Entry = OpenEntry(Path, Hash, SourceSize, Arena))
+	{
+		SerializeAnim(*Entry, Anim);
+		// Tracks were copied out, the mapping isn't needed past this point
+		const bool bDamaged = Entry->IsError();
+		Entry->Close();
+		if (!bDamaged)
+		{
+			CountLookup(true, Source.GetArchiveName());
+			return;
+		}
+		UE_LOG(LogTemp, Warning, TEXT("Discarding damaged parse cache entry '%s'"), *Path);
+		Anim.BonesInfos.Reset();
+		IFileManager::Get().Delete(*Path, false, false, true);
+	}
+	CountLookup(false, Source.GetArchiveName());
+	Anim.ParseAnim(Source);
+	if (Source.IsError())
+	{
+		return;
+	}
+	TArray<uint8> Payload;
+	FMemoryWriter Writer(Payload);
+	WriteEntryHeader(Writer, Hash, SourceSize);
+	SerializeAnim(Writer, Anim);
+	WriteEntry(Path, Payload);
+}
@@ -0,0 +1,112 @@
+﻿#include "Utils/C2MReader.h"
+
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+
+C2MReader::C2MReader()
+	: Data(nullptr)
+	, Size(0)
+	, Offset(0)
+{
+	SetIsLoading(true);
+	SetIsPersistent(true);
+}
+
+C2MReader::C2MReader(const uint8* InData, int64 InSize, const FString& InName)
+	: C2MReader()
+{
+	ArchiveName = InName;
+	SetBuffer(InData, InSize);
+}
+
+void C2MReader::SetBuffer(const uint8* InData, int64 InSize)
+{
+	Data = InData;
+	Size = InData ? InSize : 0;
+	Offset = 0;
+}
+
+void C2MReader::Serialize(void* V, int64 Length)
+{
+	if (Length <= 0)
+	{
+		return;
+	}
+	if (IsError() || Offset + Length > Size)
+	{
+		// Never hand back garbage past the end of the file
+		FMemory::Memzero(V, Length);
+		if (!IsError())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Tried to read past the end of '%s' (%lld + %lld > %lld)"), *ArchiveName, Offset, Length, Size);
+			SetError();
+		}
+		return;
+	}
+	FMemory::Memcpy(V, Data + Offset, Length);
+	Offset += Length;
+}
+
+void C2MReader::Seek(int64 InPos)
+{
+	check(InPos >= 0 && InPos <= Size);
+	Offset = InPos;
+}
+
+bool C2MReader::Skip(int64 Length)
+{
+	if (IsError() || Length < 0 || Offset + Length > Size)
+	{
+		SetError();
+		return false;
+	}
+	Offset += Length;
+	return true;
+}
+
+C2MFileReader::C2MFileReader()
+{
+}
+
+C2MFileReader::~C2MFileReader()
+{
+	C2MFileReader::Close();
+}
+
+bool C2MFileReader::Open(const FString& Filename)
+{
+	Close();
+	ArchiveName = Filename;
+
+	// Map the file so pages are only faulted in as the parsers reach them
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedHandle.Reset(PlatformFile.OpenMapped(*Filename));
+	if (MappedHandle.IsValid() && MappedHandle->GetFileSize() > 0)
+	{
+		MappedRegion.Reset(MappedHandle->MapRegion(0, MappedHandle->GetFileSize()));
+		if (MappedRegion.IsValid())
+		{
+			SetBuffer(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize());
+			return true;
+		}
+	}
+	MappedHandle.Reset();
+
+	// Some platform files (paks, network) can't be mapped, load those the old way
+	if (!FFileHelper::LoadFileToArray(FallbackData, *Filename))
+	{
+		return false;
+	}
+	SetBuffer(FallbackData.GetData(), FallbackData.Num());
+	return true;
+}
+
+bool C2MFileReader::Close()
+{
+	// The region has to go before the handle it was mapped from
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+	FallbackData.Empty();
+	SetBuffer(nullptr, 0);
+	return !IsError();
+}
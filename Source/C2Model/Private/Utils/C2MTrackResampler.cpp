@@ -0,0 +1,79 @@
+﻿#include "Utils/C2MTrackResampler.h"
+#include "Math/VectorRegister.h"
+
+static_assert(sizeof(FQuat4f) == 4 * sizeof(float), "Quaternions are loaded as a single register");
+
+int32 C2MTrackResampler::GetDenseLength(TArrayView<const uint32> Frames)
+{
+	uint32 LastFrame = 0;
+	for (const uint32 Frame : Frames)
+	{
+		LastFrame = FMath::Max(LastFrame, Frame);
+	}
+	return Frames.Num() > 0 ? static_cast<int32>(LastFrame) + 1 : 0;
+}
+
+/**
+* Shared key walk. Segment(From, To, FirstFrame, LastFrame, Out) writes the interpolated samples strictly between
+* two keys, the keys themselves are copied. Keys that don't move forward in time just overwrite their frame
+*/
+template <typename T, typename SegmentType>
+static void ResampleKeys(TArrayView<const uint32> Frames, TArrayView<const T> Values, TArrayView<T> Out, SegmentType Segment)
+{
+	check(Frames.Num() == Values.Num() && Out.Num() >= C2MTrackResampler::GetDenseLength(Frames));
+	if (Frames.Num() == 0)
+	{
+		return;
+	}
+	for (uint32 Frame = 0; Frame < Frames[0]; Frame++)
+	{
+		Out[Frame] = Values[0];
+	}
+	Out[Frames[0]] = Values[0];
+	for (int32 Key = 1; Key < Frames.Num(); Key++)
+	{
+		const uint32 From = Frames[Key - 1];
+		const uint32 To = Frames[Key];
+		if (To > From + 1)
+		{
+			Segment(Values[Key - 1], Values[Key], From, To, Out.GetData());
+		}
+		Out[To] = Values[Key];
+	}
+}
+
+void C2MTrackResampler::ResampleVectors(TArrayView<const uint32> Frames, TArrayView<const FVector3f> Values, TArrayView<FVector3f> Out)
+{
+	ResampleKeys(Frames, Values, Out, [](const FVector3f& A, const FVector3f& B, uint32 From, uint32 To, FVector3f* Samples)
+	{
+		const VectorRegister4Float Start = VectorLoadFloat3(&A);
+		const VectorRegister4Float Delta = VectorSubtract(VectorLoadFloat3(&B), Start);
+		const float InvSpan = 1.0f / static_cast<float>(To - From);
+		for (uint32 Frame = From + 1; Frame < To; Frame++)
+		{
+			const VectorRegister4Float Alpha = VectorSetFloat1(static_cast<float>(Frame - From) * InvSpan);
+			VectorStoreFloat3(VectorMultiplyAdd(Delta, Alpha, Start), &Samples[Frame]);
+		}
+	});
+}
+
+void C2MTrackResampler::ResampleRotations(TArrayView<const uint32> Frames, TArrayView<const FQuat4f> Values, TArrayView<FQuat4f> Out)
+{
+	ResampleKeys(Frames, Values, Out, [](const FQuat4f& A, const FQuat4f& B, uint32 From, uint32 To, FQuat4f* Samples)
+	{
+		const VectorRegister4Float Start = VectorLoad(&A.X);
+		VectorRegister4Float End = VectorLoad(&B.X);
+		// q and -q are the same rotation, blend towards whichever is closer so we take the short way round
+		if ((A | B) < 0.0f)
+		{
+			End = VectorNegate(End);
+		}
+		const VectorRegister4Float Delta = VectorSubtract(End, Start);
+		const float InvSpan = 1.0f / static_cast<float>(To - From);
+		for (uint32 Frame = From + 1; Frame < To; Frame++)
+		{
+			const VectorRegister4Float Alpha = VectorSetFloat1(static_cast<float>(Frame - From) * InvSpan);
+			VectorStore(VectorNormalizeQuaternion(VectorMultiplyAdd(Delta, Alpha, Start)), &Samples[Frame].X);
+		}
+	});
+}
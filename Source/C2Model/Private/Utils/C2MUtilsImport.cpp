@@ -1,4 +1,12 @@
 #include "Utils/C2MUtilsImport.h"
+#include "Math/VectorRegister.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#define C2M_SSE2_INDICES 1
+#else
+#define C2M_SSE2_INDICES 0
+#endif
 
 FVector3f C2MUtilsImport::ConvertDir(FVector3f Vector)
 {
@@ -8,4 +16,115 @@ FVector3f C2MUtilsImport::ConvertDir(FVector3f Vector)
 	Out[2] = Vector[2];
 
 	return Out;
-}
\ No newline at end of file
+}
+
+void C2MUtilsImport::FlipY(TArrayView<FVector3f> Vectors)
+{
+	// 4 packed vectors are 12 floats, so the sign pattern repeats every 3 registers
+	const VectorRegister4Float Sign0 = MakeVectorRegisterFloat(1.0f, -1.0f, 1.0f, 1.0f);
+	const VectorRegister4Float Sign1 = MakeVectorRegisterFloat(-1.0f, 1.0f, 1.0f, -1.0f);
+	const VectorRegister4Float Sign2 = MakeVectorRegisterFloat(1.0f, 1.0f, -1.0f, 1.0f);
+
+	float* Floats = reinterpret_cast<float*>(Vectors.GetData());
+	const int32 NumBlocks = Vectors.Num() / 4;
+	for (int32 Block = 0; Block < NumBlocks; Block++, Floats += 12)
+	{
+		VectorStore(VectorMultiply(VectorLoad(Floats), Sign0), Floats);
+		VectorStore(VectorMultiply(VectorLoad(Floats + 4), Sign1), Floats + 4);
+		VectorStore(VectorMultiply(VectorLoad(Floats + 8), Sign2), Floats + 8);
+	}
+	for (int32 i = NumBlocks * 4; i < Vectors.Num(); i++)
+	{
+		Vectors[i].Y = -Vectors[i].Y;
+	}
+}
+
+void C2MUtilsImport::FlipRotationsY(TArrayView<FQuat4f> Rotations)
+{
+	static_assert(sizeof(FQuat4f) == 4 * sizeof(float), "Quaternions are processed one register each");
+	const VectorRegister4Float Sign = MakeVectorRegisterFloat(-1.0f, 1.0f, -1.0f, 1.0f);
+	float* Floats = reinterpret_cast<float*>(Rotations.GetData());
+	for (int32 i = 0; i < Rotations.Num(); i++, Floats += 4)
+	{
+		VectorStore(VectorMultiply(VectorLoad(Floats), Sign), Floats);
+	}
+}
+
+FQuat4f C2MUtilsImport::FlipRotationY(const FQuat4f& Rotation)
+{
+	return FQuat4f(-Rotation.X, Rotation.Y, -Rotation.Z, Rotation.W);
+}
+
+void C2MUtilsImport::WidenIndices8(const uint8* Source, int64 Count, uint32* OutIndices)
+{
+	int64 i = 0;
+#if C2M_SSE2_INDICES
+	const __m128i Zero = _mm_setzero_si128();
+	for (; i + 16 <= Count; i += 16)
+	{
+		const __m128i Bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source + i));
+		const __m128i ShortsLo = _mm_unpacklo_epi8(Bytes, Zero);
+		const __m128i ShortsHi = _mm_unpackhi_epi8(Bytes, Zero);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(OutIndices + i), _mm_unpacklo_epi16(ShortsLo, Zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(OutIndices + i + 4), _mm_unpackhi_epi16(ShortsLo, Zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(OutIndices + i + 8), _mm_unpacklo_epi16(ShortsHi, Zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(OutIndices + i + 12), _mm_unpackhi_epi16(ShortsHi, Zero));
+	}
+#endif
+	for (; i < Count; i++)
+	{
+		OutIndices[i] = Source[i];
+	}
+}
+
+void C2MUtilsImport::WidenIndices16(const uint8* Source, int64 Count, uint32* OutIndices)
+{
+	int64 i = 0;
+#if C2M_SSE2_INDICES
+	const __m128i Zero = _mm_setzero_si128();
+	for (; i + 8 <= Count; i += 8)
+	{
+		const __m128i Shorts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source + i * sizeof(uint16)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(OutIndices + i), _mm_unpacklo_epi16(Shorts, Zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(OutIndices + i + 4), _mm_unpackhi_epi16(Shorts, Zero));
+	}
+#endif
+	for (; i < Count; i++)
+	{
+		uint16 Index;
+		FMemory::Memcpy(&Index, Source + i * sizeof(uint16), sizeof(uint16));
+		OutIndices[i] = Index;
+	}
+}
+
+void C2MUtilsImport::ReverseWindingAndOffset(uint32* Indices, int64 FaceCount, uint32 BaseVertex)
+{
+	// 4 triangles fill 3 registers: A = [0 1 2 3] B = [4 5 6 7] C = [8 9 10 11]
+	// and have to come out as [2 1 0 5] [4 3 8 7] [6 11 10 9]
+	const VectorRegister4Int Base = VectorIntSet1(static_cast<int32>(BaseVertex));
+	int64 Face = 0;
+	for (; Face + 4 <= FaceCount; Face += 4)
+	{
+		uint32* Block = Indices + Face * 3;
+		const VectorRegister4Float A = VectorCastIntToFloat(VectorIntAdd(VectorIntLoad(Block), Base));
+		const VectorRegister4Float B = VectorCastIntToFloat(VectorIntAdd(VectorIntLoad(Block + 4), Base));
+		const VectorRegister4Float C = VectorCastIntToFloat(VectorIntAdd(VectorIntLoad(Block + 8), Base));
+
+		const VectorRegister4Float A0B1 = VectorShuffle(A, B, 0, 0, 1, 1); // [0 0 5 5]
+		const VectorRegister4Float B0A3 = VectorShuffle(B, A, 0, 0, 3, 3); // [4 4 3 3]
+		const VectorRegister4Float C0B3 = VectorShuffle(C, B, 0, 0, 3, 3); // [8 8 7 7]
+		const VectorRegister4Float B2C3 = VectorShuffle(B, C, 2, 2, 3, 3); // [6 6 11 11]
+
+		VectorIntStore(VectorCastFloatToInt(VectorShuffle(A, A0B1, 2, 1, 0, 2)), Block);
+		VectorIntStore(VectorCastFloatToInt(VectorShuffle(B0A3, C0B3, 0, 2, 0, 2)), Block + 4);
+		VectorIntStore(VectorCastFloatToInt(VectorShuffle(B2C3, C, 0, 2, 2, 1)), Block + 8);
+	}
+	for (; Face < FaceCount; Face++)
+	{
+		uint32* Triangle = Indices + Face * 3;
+		const uint32 First = Triangle[0];
+		Triangle[0] = Triangle[2] + BaseVertex;
+		Triangle[1] = Triangle[1] + BaseVertex;
+		Triangle[2] = First + BaseVertex;
+	}
+}
@@ -5,6 +5,17 @@
 #include "CoreMinimal.h"
 #include "UObject/NoExportTypes.h"
 #include "SAnimOptions.generated.h"
+
+UENUM(BlueprintType)
+enum class EUnanimatedBoneMode : uint8
+{
+	/** Every skeleton bone gets a full track holding its refpose */
+	Dense UMETA(DisplayName = "Dense Refpose Track"),
+	/** Bones the animation doesn't touch get a single refpose key */
+	ConstantKey UMETA(DisplayName = "Single Refpose Key"),
+	/** Bones the animation doesn't touch get no track and fall back to the skeleton's refpose */
+	Skip UMETA(DisplayName = "No Track")
+};
 /**
  *
  */
@@ -27,6 +38,30 @@ public:
 	bool bUseCurveeSave=false;
 
 	
+	UPROPERTY(EditAnywhere, Category = "Anim Settings", meta = (ToolTip = "Tracks written for skeleton bones the animation doesn't animate (non absolute animations)"))
+	EUnanimatedBoneMode UnanimatedBoneMode = EUnanimatedBoneMode::Dense;
+
+	UPROPERTY(EditAnywhere, Category = "Key Reduction", meta = (ToolTip = "Remove keys that interpolating the neighbouring keys reproduces within the tolerances below. Only applies when saving to curves, bone tracks always hold one key per frame"))
+	bool bReduceKeys = false;
+
+	UPROPERTY(EditAnywhere, Category = "Key Reduction", meta = (ToolTip = "Largest position error a removed key may leave, in cm", EditCondition = "bReduceKeys", ClampMin = "0"))
+	float PositionTolerance = 0.01f;
+
+	UPROPERTY(EditAnywhere, Category = "Key Reduction", meta = (ToolTip = "Largest rotation error a removed key may leave, in degrees. Checked between quaternion keys, the euler curves written from them can stray further between keys", EditCondition = "bReduceKeys", ClampMin = "0"))
+	float RotationTolerance = 0.1f;
+
+	UPROPERTY(EditAnywhere, Category = "Key Reduction", meta = (ToolTip = "Largest scale error a removed key may leave", EditCondition = "bReduceKeys", ClampMin = "0"))
+	float ScaleTolerance = 0.001f;
+
+	UPROPERTY(EditAnywhere, Category = "Frame Range", meta = (ToolTip = "Only import the frames between Start Frame and End Frame, the sequence starts at Start Frame"))
+	bool bImportFrameRange = false;
+
+	UPROPERTY(EditAnywhere, Category = "Frame Range", meta = (ToolTip = "First frame to import", EditCondition = "bImportFrameRange", ClampMin = "0"))
+	int32 StartFrame = 0;
+
+	UPROPERTY(EditAnywhere, Category = "Frame Range", meta = (ToolTip = "Last frame to import (inclusive), clamped to the animation's length", EditCondition = "bImportFrameRange", ClampMin = "0"))
+	int32 EndFrame = 0;
+
 	UPROPERTY(EditAnywhere, Category = "Anim Settings", meta = (ToolTip = "Override the refpose if enabled"))
 	bool bOverrideRefpose;
 	
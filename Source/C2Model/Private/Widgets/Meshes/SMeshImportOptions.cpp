@@ -12,7 +12,7 @@
 BEGIN_SLATE_FUNCTION_BUILD_OPTIMIZATION
 void SMeshImportOptions::Construct(const FArguments& InArgs)
 {
-	MeshHeader = InArgs._MeshHeader;
+	MeshProbe = InArgs._MeshProbe;
 	WidgetWindow = InArgs._WidgetWindow;
 	FPropertyEditorModule& EditModule = FModuleManager::Get().GetModuleChecked<FPropertyEditorModule>("PropertyEditor");
 	FDetailsViewArgs DetailsViewArgs;
@@ -93,14 +93,14 @@ void SMeshImportOptions::Construct(const FArguments& InArgs)
 		]
 	];
 
-	ImportMapHeaderDisplay->SetContent(CreateMapHeader(MeshHeader).ToSharedRef());
+	ImportMapHeaderDisplay->SetContent(CreateMapHeader(MeshProbe).ToSharedRef());
 
 
 }
 
-TSharedPtr<SBorder> SMeshImportOptions::CreateMapHeader(C2Mesh* MeshHeader)
+TSharedPtr<SBorder> SMeshImportOptions::CreateMapHeader(const C2MeshProbe* MeshProbe)
 {
-	check(MeshHeader);
+	check(MeshProbe);
 	return SNew(SBorder)
 		.Padding(FMargin(3))
 		.BorderImage(FAppStyle::GetBrush("ToolPanel.GroupBorder"))
@@ -110,22 +110,22 @@ TSharedPtr<SBorder> SMeshImportOptions::CreateMapHeader(C2Mesh* MeshHeader)
 			+ SVerticalBox::Slot()
 			.AutoHeight()
 			[
-				AddNewHeaderProperty(FText::FromString("Model: "),FText::FromString(MeshHeader->Header->MeshName)).ToSharedRef()
+				AddNewHeaderProperty(FText::FromString("Model: "),FText::FromString(MeshProbe->Header.MeshName)).ToSharedRef()
 			]
 			+ SVerticalBox::Slot()
 			.AutoHeight()
 			[
-				AddNewHeaderProperty(FText::FromString("Vertices:"),FText::AsNumber(MeshHeader->surf_vertCounter)).ToSharedRef()
+				AddNewHeaderProperty(FText::FromString("Vertices:"),FText::AsNumber(MeshProbe->VertexCount)).ToSharedRef()
 			]
 			+ SVerticalBox::Slot()
 			.AutoHeight()
 			[
-				AddNewHeaderProperty(FText::FromString("Materials:"),FText::AsNumber(MeshHeader->Header->MaterialCountBuffer)).ToSharedRef()
+				AddNewHeaderProperty(FText::FromString("Materials:"),FText::AsNumber(MeshProbe->Header.MaterialCountBuffer)).ToSharedRef()
 			]
 			+ SVerticalBox::Slot()
 			.AutoHeight()
 			[
-				AddNewHeaderProperty(FText::FromString("Bones:"),FText::AsNumber(MeshHeader->Header->BoneCountBuffer)).ToSharedRef()
+				AddNewHeaderProperty(FText::FromString("Bones:"),FText::AsNumber(MeshProbe->Header.BoneCountBuffer)).ToSharedRef()
 			]
 		];
 }
@@ -14,11 +14,11 @@ class C2MODEL_API SMeshImportOptions : public SCompoundWidget
 {
 public:
 	SLATE_BEGIN_ARGS(SMeshImportOptions)
-		: _MeshHeader(nullptr)
+		: _MeshProbe(nullptr)
 		, _WidgetWindow()
 	{}
 
-	SLATE_ARGUMENT(C2Mesh*, MeshHeader)
+	SLATE_ARGUMENT(const C2MeshProbe*, MeshProbe)
 	SLATE_ARGUMENT(TSharedPtr<SWindow>, WidgetWindow)
     
 	SLATE_END_ARGS()
@@ -29,7 +29,7 @@ public:
 	/** Constructs this widget with InArgs */
 	void Construct(const FArguments& InArgs);
 	static TSharedPtr<SHorizontalBox> AddNewHeaderProperty(FText InKey, FText InValue);
-	static TSharedPtr<SBorder> CreateMapHeader(C2Mesh* MeshHeader);
+	static TSharedPtr<SBorder> CreateMapHeader(const C2MeshProbe* MeshProbe);
 	/** A property view to edit advanced options */
 	TSharedPtr< class IDetailsView >				PropertyView;
 
@@ -50,7 +50,7 @@ public:
 
 	FReply OnCancel();
 private:
-	C2Mesh* MeshHeader;
+	const C2MeshProbe* MeshProbe;
 	EPSAImportOptionDlgResponse		UserDlgResponse;
 	FReply HandleImport();
 
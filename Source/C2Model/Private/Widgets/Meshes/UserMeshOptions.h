@@ -39,6 +39,15 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Mesh Settings", meta = (DisplayName = "Mesh Type", EditCondition = "!bAutomaticallyDecideMeshType"))
 	EMeshType MeshType;
 
+	// Merges source vertices that share a position into one vertex, normals, UVs and colors stay per corner.
+	// Skeletal meshes only merge vertices whose skin influences are identical.
+	UPROPERTY(EditAnywhere, Category = "Mesh Settings", meta = (DisplayName = "Weld Vertices", Tooltip = "Share one vertex between source vertices closer than the weld threshold, split seams keep their own normals, UVs and colors."))
+	bool bWeldVertices = false;
+
+	// Largest distance between two vertices that get welded, in cm.
+	UPROPERTY(EditAnywhere, Category = "Mesh Settings", meta = (DisplayName = "Weld Threshold", EditCondition = "bWeldVertices", ClampMin = "0"))
+	float WeldThreshold = 0.0001f;
+
 	// Determines whether materials should be imported along with the mesh.
 	UPROPERTY(EditAnywhere, Category = "Material Settings", meta = (DisplayName = "Import Materials"))
 	bool bImportMaterials = true;
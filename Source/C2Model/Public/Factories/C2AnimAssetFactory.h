@@ -5,6 +5,7 @@
 #include "Factories/Factory.h"
 #include "Structures/C2Anim.h"
 #include "UObject/ObjectMacros.h"
+#include "Utils/C2MArena.h"
 #include "Widgets/Animations/SAnimOptions.h"
 #include "C2AnimAssetFactory.generated.h"
 
@@ -41,8 +42,25 @@ public:
 
 
 	TArray<FC2Anims> TracksAll;
-	FMeshBoneInfo GetBone(const FString& AnimBoneName);
-	int GetBoneIndex(const FString& AnimBoneName);
+	/* Map every animated bone to its skeleton index (INDEX_NONE if the skeleton doesn't have it), flagging misses in OutUnmatched */
+	void ResolveAnimBones(const C2Anim& Anim, TArray<int32>& OutSkeletonIndices, TBitArray<>& OutUnmatched);
 //	virtual UObject* FactoryCreateBinary(UClass* Class, UObject* InParent, FName Name, EObjectFlags Flags, UObject* Context, const TCHAR* Type, const uint8*& Buffer, const uint8* BufferEnd, FFeedbackContext* Warn) override;
 	virtual UObject* FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename, const TCHAR* Parms, FFeedbackContext* Warn, bool& bOutOperationCanceled) override;
+private:
+	/* Rebuild the bone name lookup when the target skeleton changed since the previous file of the batch */
+	void CacheBoneIndices(const USkeleton* Skeleton);
+	/* Local space override pose of every skeleton bone, evaluated once from RefposeSequence at PoseTime and reused for the batch */
+	const TArray<FTransform>& GetRefposeOverride(const USkeleton* Skeleton);
+
+	// Owns the parsed animation, reset after each file and reused for the rest of the batch
+	C2MArena ParseArena;
+	// Bone name to skeleton index of CachedSkeleton
+	TMap<FName, int32> BoneIndexByName;
+	TWeakObjectPtr<const USkeleton> CachedSkeleton;
+	int32 CachedSkeletonBoneCount = 0;
+	// Evaluated refpose override and what it was evaluated from
+	TArray<FTransform> RefposeTransforms;
+	TWeakObjectPtr<UAnimSequence> CachedRefposeSequence;
+	TWeakObjectPtr<const USkeleton> CachedRefposeSkeleton;
+	int32 CachedPoseTime = INDEX_NONE;
 };
@@ -4,6 +4,7 @@
 
 #include "Factories/Factory.h"
 #include "UObject/ObjectMacros.h"
+#include "Utils/C2MArena.h"
 #include "C2ModelAssetFactory.generated.h"
 
 
@@ -12,6 +13,8 @@
  */
 
 class UUserMeshOptions;
+class C2Mesh;
+class C2MReader;
 UCLASS(hidecategories=Object)
 class UC2ModelAssetFactory
 	: public UFactory
@@ -28,4 +31,10 @@ public:
 //	virtual UObject* FactoryCreateBinary(UClass* Class, UObject* InParent, FName Name, EObjectFlags Flags, UObject* Context, const TCHAR* Type, const uint8*& Buffer, const uint8* BufferEnd, FFeedbackContext* Warn) override;
 	virtual UObject* FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename, const TCHAR* Parms, FFeedbackContext* Warn, bool& bOutOperationCanceled) override;
 	static UObject* ImportTexture(FString FilePath, UObject* InParent);
+private:
+	/* Parses the file and, when it is an _LOD0, its _LOD1.._LODn siblings concurrently. The result starts with the file
+	 * itself and stops at the first LOD that is missing or fails to open */
+	TArray<C2Mesh*> ParseLODs(const FString& Filename, C2MReader& BaseReader);
+	// Owns the parse results of the file being imported, reset after each one and reused for the rest of the batch
+	C2MArena ParseArena;
 };
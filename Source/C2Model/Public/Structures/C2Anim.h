@@ -38,48 +38,52 @@ struct WraithAnimFrame
     }
 };
 
+// Keyframes of one channel stored as parallel arrays: key K is at frame Frames[K] with value Values[K]
+template<class T>
+struct C2AnimTrack
+{
+    TArray<uint32_t> Frames;
+    TArray<T> Values;
+
+    int32 Num() const { return Frames.Num(); }
+    bool IsEmpty() const { return Frames.IsEmpty(); }
+
+    // Gather one key back together, for code that walks keys one at a time
+    WraithAnimFrame<T> operator[](int32 Index) const
+    {
+        return { Frames[Index], Values[Index] };
+    }
+
+    int32 FindKey(uint32_t FrameToCheck) const
+    {
+        return Frames.Find(FrameToCheck);
+    }
+};
+
 struct BoneInfo
 {
-    FString Name;
+    FName Name;
     int index;
-    TArray<WraithAnimFrame<FVector3f>> BonePositions;
-    TArray<WraithAnimFrame<FQuat4f>> BoneRotations;
-    TArray<WraithAnimFrame<FVector3f>> BoneScale;
+    C2AnimTrack<FVector3f> BonePositions;
+    C2AnimTrack<FQuat4f> BoneRotations;
+    C2AnimTrack<FVector3f> BoneScale;
 
     FVector3f GetPositionAtFrame(uint32_t FrameAsked) const
     {
-        for (const auto& var : BonePositions)
-        {
-            if (var.HasFrame(FrameAsked))
-            {
-                return var.Value;
-            }
-        }
-        return FVector3f(-1,-1,-1);
+        const int32 Key = BonePositions.FindKey(FrameAsked);
+        return Key != INDEX_NONE ? BonePositions.Values[Key] : FVector3f(-1,-1,-1);
     }
 
     FQuat4f GetRotationAtFrame(uint32_t FrameAsked) const
     {
-        for (const auto& var : BoneRotations)
-        {
-            if (var.HasFrame(FrameAsked))
-            {
-                return var.Value;
-            }
-        }
-        return FQuat4f(-1, -1, -1, -1);
+        const int32 Key = BoneRotations.FindKey(FrameAsked);
+        return Key != INDEX_NONE ? BoneRotations.Values[Key] : FQuat4f(-1, -1, -1, -1);
     }
 
     FVector3f GetScaleAtFrame(uint32_t FrameAsked) const
     {
-        for (const auto& var : BoneScale)
-        {
-            if (var.HasFrame(FrameAsked))
-            {
-                return var.Value;
-            }
-        }
-        return FVector3f(-1, -1, -1);
+        const int32 Key = BoneScale.FindKey(FrameAsked);
+        return Key != INDEX_NONE ? BoneScale.Values[Key] : FVector3f(-1, -1, -1);
     }
 };
 
@@ -111,21 +115,51 @@ enum class ESEAnimDataPresenceFlags : uint8
     SEANIM_PRESENCE_CUSTOM = 1 << 7
 };
 
+// What a probe learns about a .seanim without decoding its keyframes
+struct C2AnimProbe
+{
+    FAnimHeader Header;
+    TArray<FName> BoneNames;
+};
+
 class C2MODEL_API C2Anim
 {
 public:
 	C2Anim(){};
 	
-	void ParseAnim(FLargeMemoryReader& Reader);
-    void ParseHeader(FLargeMemoryReader& Reader);
-    TArray<FString> ParseBoneNames(FLargeMemoryReader& Reader) const;
-    TArray<AnimationBoneModifier> ParseAnimModifiers(FLargeMemoryReader& Reader) const;
-    void ParseBoneData(FLargeMemoryReader& Reader, const TArray<AnimationBoneModifier>& AnimModifiers, const TArray<FString>& BoneNames);
+	void ParseAnim(C2MReader& Reader);
+    /* Only keep keys inside [StartFrame, EndFrame] (inclusive), rebased so StartFrame becomes frame 0.
+     * Call before ParseAnim, Header.FrameCountBuffer then reports the length of the slice */
+    void SetFrameRange(uint32_t StartFrame, uint32_t EndFrame);
+    bool HasFrameRange() const { return bHasFrameRange; }
+    void ParseHeader(C2MReader& Reader);
+    /* Read the header and bone name table only, leaving the reader at the start of the modifiers */
+    static bool Probe(C2MReader& Reader, C2AnimProbe& OutProbe);
+    TArray<FName> ParseBoneNames(C2MReader& Reader) const;
+    TArray<AnimationBoneModifier> ParseAnimModifiers(C2MReader& Reader) const;
+    void ParseBoneData(C2MReader& Reader, const TArray<AnimationBoneModifier>& AnimModifiers, const TArray<FName>& BoneNames);
     FAnimHeader Header;
     TArray<BoneInfo> BonesInfos;
-    template <typename T>
-    void ParseKeyframeData(FLargeMemoryReader& Reader, TArray<WraithAnimFrame<T>>& KeyframeArray);
+    // Frame indices (and key counts) are 8, 16 or 32 bit depending on the frame count, picked once per file
+    template <typename FrameIndexType>
+    void ParseBoneTracks(C2MReader& Reader, const TArray<FName>& BoneNames);
+    template <typename FrameIndexType, typename T>
+    static void ParseKeyframeData(C2MReader& Reader, C2AnimTrack<T>& Track);
+    // Streams the keys and stores only the slice, the keys bracketing it are interpolated onto its first and last frame
+    template <typename FrameIndexType, typename T>
+    static void ParseKeyframeRange(C2MReader& Reader, C2AnimTrack<T>& Track, uint32_t StartFrame, uint32_t EndFrame);
+    /* Drop keys that interpolating their neighbours reproduces within tolerance (position units, rotation degrees, scale).
+     * A channel that never leaves tolerance of its first key collapses to a single key at frame 0.
+     * Rotations are checked against quaternion interpolation, not against the euler curves the factory writes from them */
+    void ReduceKeys(float PositionTolerance, float RotationToleranceDegrees, float ScaleTolerance);
+    // Components that are (almost) zero fall back to the initial pose's component
     static FQuat4f FixRotationAbsolute(FQuat4f QuatRot, FQuat4f InitialRot);
     static FVector3f FixPositionAbsolute(FVector3f QuatPos, FVector3f InitialPos);
+    static void FixRotationsAbsolute(TArrayView<FQuat4f> Rotations, const FQuat4f& InitialRot);
+    static void FixPositionsAbsolute(TArrayView<FVector3f> Positions, const FVector3f& InitialPos);
+private:
+    bool bHasFrameRange = false;
+    uint32_t RangeStart = 0;
+    uint32_t RangeEnd = MAX_uint32;
 };
 
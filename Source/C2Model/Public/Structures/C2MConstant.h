@@ -3,7 +3,7 @@
 #include "Enums.h"
 #include <map>
 
-#include "Serialization/LargeMemoryReader.h"
+#include "Utils/C2MReader.h"
 
 //std::map<uint8_t,CoDMaterialSetting> ConstantTypes =
 //{
@@ -22,5 +22,5 @@ public:
 	uint32_t Hash;
 	FVector4 Value;
 
-	void ParseConstant(FLargeMemoryReader& Reader);
+	void ParseConstant(C2MReader& Reader);
 };
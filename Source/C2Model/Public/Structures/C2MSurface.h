@@ -2,33 +2,35 @@
 
 #include "Shared.h"
 #include "Utils/BinaryReader.h"
-#include "Serialization/LargeMemoryReader.h"
-struct C2Weight
-{
-	uint32_t VertexIndex;
-	uint32_t WeightID;
-	float WeightValue;
-
-};
-struct C2MVertex
-{
-	FVector3f Vertice;
-	FVector3f Normal;
-	FVector2f UV;
-	GfxColor Color;
-	TArray<C2Weight> Weights;
-};
+#include "Utils/C2MReader.h"
+#include "Utils/C2MArena.h"
+#include "C2MeshHeader.h"
 
 class C2MODEL_API C2MSurface
 
 {
 public:
+	/* Decodes the per-vertex streams of one surface, picked once per file from the mesh presence flags */
+	typedef void (C2MSurface::*StreamDecoder)(C2MReader& Reader);
+	static StreamDecoder GetStreamDecoder(const C2MeshHeader& Header);
+
 	C2MSurface();
 	C2MSurface(C2MSurface* InSurface);
 	C2MSurface(FString InName);
 	FString Name;
-	TArray< C2MVertex> Vertexes;
-	TArray<GfxFace> Faces;
+	// Decoded streams are allocated from this arena and live until it is reset
+	C2MArena* Arena = nullptr;
+	// Per-vertex streams, one entry per vertex. Positions and normals are already converted to Unreal's Y axis.
+	// Streams the file doesn't contain are left empty. They are read only once decoded, a cached surface maps them from disk
+	TArrayView<const FVector3f> Positions;
+	// UVCount sets per vertex, vertex major: vertex V set S lives at [V * UVCount + S]
+	TArrayView<const FVector2f> UVs;
+	TArrayView<const FVector3f> Normals;
+	TArrayView<const GfxColor> Colors;
+	// Skin influences, MaxSkinBuffer slots per vertex: vertex V owns [V * MaxSkinBuffer, (V + 1) * MaxSkinBuffer)
+	TArrayView<const uint32_t> WeightBoneIDs;
+	TArrayView<const float> WeightValues;
+	TArrayView<const GfxFace> Faces;
 	TArray<int32_t> Materials;
 	uint8_t UVCount;
 
@@ -41,9 +43,17 @@ public:
 	uint32_t VertCount;
 	uint8_t MaxSkinBuffer;
 	//
-	void ParseSurface(FLargeMemoryReader& Reader,uint32_t buffer_BoneCount,uint16_t surfCount,int global_SurfVertCounter );
-	TArray<GfxFace> ParseFaces(FLargeMemoryReader& Reader );
-	TArray<C2Weight> ParseWeight(FLargeMemoryReader& Reader, uint32_t CurrentVertIndex);
+	void ParseSurface(C2MReader& Reader, StreamDecoder DecodeStreams, uint32_t buffer_BoneCount,uint16_t surfCount,int global_SurfVertCounter );
+	// ParseSurface split in two, so the headers can be scanned first and the bodies decoded in any order
+	void ParseSurfaceHeader(C2MReader& Reader, uint32_t buffer_BoneCount, uint16_t surfCount, int global_SurfVertCounter);
+	int64 GetBodySize(const C2MeshHeader& Header) const;
+	// Arena bytes the decoded streams need, alignment padding included
+	int64 GetDecodedSize(const C2MeshHeader& Header) const;
+	void ParseSurfaceBody(C2MReader& Reader, StreamDecoder DecodeStreams);
+	template <uint8_t MeshFlags>
+	void ParseStreams(C2MReader& Reader);
+	void ParseFaces(C2MReader& Reader);
+	void ParseWeights(C2MReader& Reader);
 };
 
 
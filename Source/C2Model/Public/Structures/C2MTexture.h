@@ -1,6 +1,6 @@
 ﻿#pragma once
 #include "Utils/BinaryReader.h"
-#include "Serialization/LargeMemoryReader.h"
+#include "Utils/C2MReader.h"
 
 class C2MODEL_API C2MTexture
 {
@@ -11,6 +11,6 @@ public:
 	FString TexturePath;
 	FString TextureType;
 
-	void ParseTexture(FLargeMemoryReader& Reader);
+	void ParseTexture(C2MReader& Reader);
 	static FString NoIllegalSigns(const FString& InString);
 };
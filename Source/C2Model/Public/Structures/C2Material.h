@@ -4,16 +4,16 @@
 #include "C2MConstant.h"
 #include "C2MTexture.h"
 #include "Enums.h"
-#include "Serialization/LargeMemoryReader.h"
+#include "Utils/C2MReader.h"
 
 class C2MODEL_API C2Material
 {
 public:
 	C2Material();
 	
-	C2MaterialHeader* Header;
+	TUniquePtr<C2MaterialHeader> Header;
 	TArray<C2MTexture> Textures;
 	TArray<C2MConstant> Constants;
 	
-	void ParseMaterial(FLargeMemoryReader& Reader);
+	void ParseMaterial(C2MReader& Reader);
 };
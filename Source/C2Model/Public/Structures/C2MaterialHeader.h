@@ -2,7 +2,7 @@
 
 #include "Utils/BinaryReader.h"
 #include "Enums.h"
-#include "Serialization/LargeMemoryReader.h"
+#include "Utils/C2MReader.h"
 
 class C2MODEL_API C2MaterialHeader
 {
@@ -16,5 +16,5 @@ public:
 	uint8_t TextureCount;
 	uint8_t ConstantCount;
 	
-	void ParseHeader(FLargeMemoryReader& Reader);
+	void ParseHeader(C2MReader& Reader);
 };
@@ -8,6 +8,7 @@
 #include "Engine/StaticMesh.h"
 #include "AssetRegistry/AssetRegistryModule.h"
 #include "C2MeshHeader.h"
+#include "Utils/C2MArena.h"
 #include "Misc/ScopedSlowTask.h"
 #include "StaticMeshAttributes.h"
 
@@ -23,19 +24,35 @@ struct C2Bone
 	FString Name;
 	uint8  non;
 	uint32_t ParentIndex;
-	FVector3f  GlobalPosition;
-	FRotator3f GlobalRotation;
-	FVector3f  LocalPosition;
-	FRotator3f LocalRotation;
+	FVector3f  GlobalPosition = FVector3f::ZeroVector;
+	// Rotations are kept as read from the file, in COD's axes
+	FQuat4f GlobalRotation = FQuat4f::Identity;
+	FVector3f  LocalPosition = FVector3f::ZeroVector;
+	FQuat4f LocalRotation = FQuat4f::Identity;
+	FVector3f  Scale = FVector3f::OneVector;
 
 
 };
 
+// What a probe learns about a .semodel without decoding its bones, surfaces or materials
+struct C2MeshProbe
+{
+	C2MeshHeader Header;
+	TArray<FString> BoneNames;
+	uint32 VertexCount = 0;
+	uint32 FaceCount = 0;
+};
+
 class C2MODEL_API C2Mesh
 {
 public:
-	C2Mesh(){};
-	C2MeshHeader* Header;
+	// Without an arena the mesh keeps its own, freed together with the mesh
+	C2Mesh();
+	explicit C2Mesh(C2MArena& InArena);
+	C2Mesh(const C2Mesh&) = delete;
+	C2Mesh& operator=(const C2Mesh&) = delete;
+	// Header and surfaces are owned by the arena
+	C2MeshHeader* Header = nullptr;
 	TArray<C2Bone> Bones;
 	TArray<C2MSurface*> Surfaces;  
 	TArray<C2ModelMaterial> Materials;
@@ -44,7 +61,13 @@ public:
 	TArray<FString> TTypes = { "colorMap", "normalMap", "specularMap" };
 	int surf_vertCounter = 0;
 	uint8_t MaterialCount = 1;
+	// Widest UV set count over all surfaces
 	uint8_t UVSetCount = 1;
 	
-	void ParseMesh(FLargeMemoryReader& Reader);
+	void ParseMesh(C2MReader& Reader);
+	/* Read the header, bone names and surface headers only, skipping every other block. Leaves the reader where it stopped */
+	static bool Probe(C2MReader& Reader, C2MeshProbe& OutProbe);
+private:
+	TUniquePtr<C2MArena> OwnedArena;
+	C2MArena* Arena;
 };
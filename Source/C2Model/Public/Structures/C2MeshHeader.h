@@ -1,8 +1,9 @@
 ﻿#pragma once
-#include "Serialization/LargeMemoryReader.h"
+#include "Utils/C2MReader.h"
 
 class C2MODEL_API C2MeshHeader
 {
+public:
 	enum class SEModelDataPresenceFlags : uint8_t
 	{
 		// Whether or not this model contains a bone block
@@ -41,7 +42,6 @@ class C2MODEL_API C2MeshHeader
 		SEMODEL_PRESENCE_WEIGHTS = 1 << 3,
 	};
 
-public:
 	C2MeshHeader();
 	char Magic[7];
 	SEModelDataPresenceFlags DataPresentFlags;
@@ -54,5 +54,9 @@ public:
 	uint32_t MaterialCountBuffer;
 
 	C2MeshHeader(FString InName);
-	void ParseHeader(FLargeMemoryReader& Reader);
+	void ParseHeader(C2MReader& Reader);
+
+	bool HasData(SEModelDataPresenceFlags Flag) const { return (static_cast<uint8_t>(DataPresentFlags) & static_cast<uint8_t>(Flag)) != 0; }
+	bool HasBoneData(SEModelBonePresenceFlags Flag) const { return (static_cast<uint8_t>(BonePresentFlags) & static_cast<uint8_t>(Flag)) != 0; }
+	bool HasMeshData(SEModelMeshPresenceFlags Flag) const { return (static_cast<uint8_t>(MeshPresentFlags) & static_cast<uint8_t>(Flag)) != 0; }
 };
@@ -4,11 +4,11 @@ struct GfxColor
 {
 	uint8_t r, g, b, a;
 
-	FColor ToFColor()
+	FColor ToFColor() const
 	{
 		return FColor(this->r, this->g, this->b, this->a);
 	}
-	FVector4f ToVector()
+	FVector4f ToVector() const
 	{
 		return FVector4f(this->r / 255.0f, this->g / 255.0f, this->b / 255.0f, this->a / 255.0f);
 	}
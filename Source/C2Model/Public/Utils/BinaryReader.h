@@ -1,7 +1,9 @@
 ﻿#pragma once
 
-#include "Serialization/Archive.h"
+#include "Utils/C2MReader.h"
 #include "Containers/UnrealString.h"
+#include "Containers/ArrayView.h"
+#include <type_traits>
 
 /**
 * Base class for serializing arbitrary data in memory.
@@ -11,8 +13,82 @@ public:
 	BinaryReader(){};
 
 	
-	static void readString(FArchive& Ar, FString* outText);
+	static void readString(C2MReader& Ar, FString* outText);
+	/* Read a null terminated string and intern it, repeated names resolve to the same FName entry */
+	static FName readName(C2MReader& Ar);
 	
 	template <typename T>
-	static TArray<T> readList(FArchive& Ar, uint32_t count);
+	static TArray<T> readList(C2MReader& Ar, uint32_t count)
+	{
+		TArray<T> arr;
+		readList(Ar, count, arr);
+		return arr;
+	}
+
+	/* Read count elements into outList, reusing its allocation.
+	 * Trivially copyable types are copied with a single memcpy on little endian hosts.
+	 * A count the rest of the buffer can't hold flags the reader and leaves outList empty, before anything is allocated */
+	template <typename T>
+	static void readList(C2MReader& Ar, uint32_t count, TArray<T>& outList)
+	{
+		// Serialized elements take at least a byte each, raw copies exactly sizeof(T)
+		constexpr int64 MinElementSize = std::is_trivially_copyable_v<T> && PLATFORM_LITTLE_ENDIAN ? sizeof(T) : 1;
+		if (count > MAX_int32 || static_cast<int64>(count) * MinElementSize > Ar.GetRemaining())
+		{
+			Ar.SetError();
+			outList.Reset();
+			return;
+		}
+		if constexpr (std::is_trivially_copyable_v<T> && PLATFORM_LITTLE_ENDIAN)
+		{
+			outList.SetNumUninitialized(count);
+			Ar.Serialize(outList.GetData(), static_cast<int64>(count) * sizeof(T));
+		}
+		else
+		{
+			outList.Reset(count);
+			for (uint32_t x = 0; x < count; x++)
+			{
+				T vec;
+				Ar << vec;
+				outList.Add(vec);
+			}
+		}
+	}
+
+	/* Fill a preallocated view, e.g. arena storage sized up front */
+	template <typename T>
+	static void readList(C2MReader& Ar, TArrayView<T> outList)
+	{
+		static_assert(std::is_trivially_copyable_v<T> && PLATFORM_LITTLE_ENDIAN, "Views are filled with a raw copy");
+		Ar.Serialize(outList.GetData(), static_cast<int64>(outList.Num()) * sizeof(T));
+	}
+
+	/* View count elements in place over the reader's buffer without copying them.
+	 * The view is only valid while the buffer is alive, and elements are not aligned,
+	 * so it is meant for byte blocks and types that tolerate unaligned loads.
+	 * Returns an empty view (and flags the reader) if the count doesn't fit a view or the buffer is too short,
+	 * callers compare Num() with the count they asked for before decoding */
+	template <typename T>
+	static TArrayView<const T> readListView(C2MReader& Ar, int64 count)
+	{
+		static_assert(std::is_trivially_copyable_v<T> && PLATFORM_LITTLE_ENDIAN, "In place views need the file layout to match memory");
+		if (count < 0 || count > MAX_int32 || Ar.GetRemaining() < count * static_cast<int64>(sizeof(T)))
+		{
+			Ar.SetError();
+			return TArrayView<const T>();
+		}
+		const T* Data = reinterpret_cast<const T*>(Ar.GetCursor());
+		Ar.Skip(count * sizeof(T));
+		return TArrayView<const T>(Data, static_cast<int32>(count));
+	}
+
+	/* Load a T from a possibly unaligned position inside a block returned by readListView */
+	template <typename T>
+	static T readUnaligned(const uint8* Source)
+	{
+		T Value;
+		FMemory::Memcpy(&Value, Source, sizeof(T));
+		return Value;
+	}
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include "Containers/Array.h"
+#include "Containers/ArrayView.h"
+#include "HAL/CriticalSection.h"
+#include <type_traits>
+
+/**
+* Linear allocator owning everything parsed during one import.
+* Reset() releases it all in one go, keeping the largest block around so a batch of imports reuses the same memory.
+* Allocation is thread safe, surfaces are decoded in parallel.
+*/
+class C2MODEL_API C2MArena
+{
+public:
+	C2MArena();
+	~C2MArena();
+	C2MArena(const C2MArena&) = delete;
+	C2MArena& operator=(const C2MArena&) = delete;
+
+	void* Allocate(int64 Size, int64 Alignment = 16);
+
+	/* Make sure the next Size bytes can be served from a single block */
+	void Reserve(int64 Size);
+
+	/* Uninitialized storage for Count elements, only for types that need no destructor.
+	 * Returns an empty view when Count doesn't fit a view, callers compare Num() with the count they asked for */
+	template <typename T>
+	TArrayView<T> AllocateArray(int64 Count)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "Arena arrays are never destroyed");
+		// Bounding the count by MAX_int32 also keeps the byte size far from overflowing int64
+		static_assert(sizeof(T) <= MAX_int32, "Element too large for the size computation");
+		if (Count <= 0 || Count > MAX_int32)
+		{
+			return TArrayView<T>();
+		}
+		return TArrayView<T>(static_cast<T*>(Allocate(Count * static_cast<int64>(sizeof(T)), alignof(T))), static_cast<int32>(Count));
+	}
+
+	/* Construct a T inside the arena, its destructor runs on Reset() */
+	template <typename T, typename... ArgsType>
+	T* New(ArgsType&&... Args)
+	{
+		T* Object = new (Allocate(sizeof(T), alignof(T))) T(Forward<ArgsType>(Args)...);
+		if constexpr (!std::is_trivially_destructible_v<T>)
+		{
+			AddDestructor(Object, [](void* Ptr) { static_cast<T*>(Ptr)->~T(); });
+		}
+		return Object;
+	}
+
+	/* Destroy every object, release all blocks but the largest one and restart the peak count */
+	void Reset();
+
+	int64 GetUsedBytes() const { return UsedBytes; }
+	int64 GetPeakBytes() const { return PeakBytes; }
+	int64 GetReservedBytes() const { return ReservedBytes; }
+	/* Log peak and retained memory for an import */
+	void LogUsage(const FString& Context) const;
+
+private:
+	struct FBlock
+	{
+		uint8* Data;
+		int64 Size;
+		int64 Used;
+	};
+	struct FDestructor
+	{
+		void* Object;
+		void (*Destroy)(void*);
+	};
+
+	void AddBlock(int64 MinSize);
+	void AddDestructor(void* Object, void (*Destroy)(void*));
+
+	TArray<FBlock> Blocks;
+	TArray<FDestructor> Destructors;
+	FCriticalSection Lock;
+	int64 UsedBytes;
+	int64 PeakBytes;
+	int64 ReservedBytes;
+};
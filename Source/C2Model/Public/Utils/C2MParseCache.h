@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include "Utils/C2MReader.h"
+#include "Utils/C2MArena.h"
+
+class C2Mesh;
+class C2Anim;
+
+/**
+* Optional on-disk cache of decoded SEModel/SEAnim files, kept in Saved/C2Model/ParseCache.
+* Entries are keyed by the content hash of the source file and the parser version, so edited exports
+* and parser changes simply miss. Mesh streams are stored aligned and mapped straight back into the surfaces.
+* Enabled with C2M.ParseCache, bounded by C2M.ParseCache.MaxSizeMB (least recently used entries go first).
+*/
+class C2MODEL_API C2MParseCache
+{
+public:
+	/* Fill Mesh from the cache, or parse Source and store the result. Cached streams stay mapped until Arena is reset */
+	static void ParseMesh(C2MReader& Source, C2Mesh& Mesh, C2MArena& Arena);
+	/* Same for animations, cached tracks are copied out since the factory consumes them right away */
+	static void ParseAnim(C2MReader& Source, C2Anim& Anim, C2MArena& Arena);
+
+	static bool IsEnabled();
+	static int32 GetHitCount() { return Hits; }
+	static int32 GetMissCount() { return Misses; }
+
+private:
+	// Bump whenever the decoded layout of C2Mesh/C2Anim or the cache layout changes
+	static constexpr uint32 ParserVersion = 3;
+
+	static FString GetCacheDir();
+	static FString GetEntryPath(uint64 Hash, const TCHAR* Extension);
+	static uint64 HashSource(C2MReader& Source);
+	/* Open an entry and check that it was written for this source, returns nullptr on a miss */
+	static C2MFileReader* OpenEntry(const FString& Path, uint64 Hash, int64 SourceSize, C2MArena& Arena);
+	static void WriteEntryHeader(FArchive& Writer, uint64 Hash, int64 SourceSize);
+	/* Save a finished entry and trim the cache back under its size budget */
+	static void WriteEntry(const FString& Path, const TArray<uint8>& Payload);
+	/* Add a new entry to the running size, the directory is only scanned once that goes over budget */
+	static void Evict(int64 AddedBytes);
+	static void CountLookup(bool bHit, const FString& SourceName);
+
+	static int32 Hits;
+	static int32 Misses;
+	static int32 Evictions;
+	// Bytes on disk as of the last scan plus what was written since, INDEX_NONE until the first scan
+	static int64 CacheSize;
+};
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include "Serialization/Archive.h"
+#include "Async/MappedFileHandle.h"
+#include "Containers/UnrealString.h"
+#include "Templates/UniquePtr.h"
+
+/**
+* Read-only cursor over a contiguous block of bytes.
+* Works like FLargeMemoryReader, but exposes the underlying buffer so blocks can be decoded in place.
+*/
+class C2MODEL_API C2MReader : public FArchive
+{
+public:
+	C2MReader(const uint8* InData, int64 InSize, const FString& InName = FString());
+
+	virtual void Serialize(void* V, int64 Length) override;
+	virtual int64 Tell() override { return Offset; }
+	virtual int64 TotalSize() override { return Size; }
+	virtual void Seek(int64 InPos) override;
+	virtual FString GetArchiveName() const override { return ArchiveName; }
+
+	const uint8* GetData() const { return Data; }
+	const uint8* GetCursor() const { return Data + Offset; }
+	int64 GetRemaining() const { return Size - Offset; }
+
+	/* Move the cursor forward without copying anything
+	 * @Length - Number of bytes to skip
+	 * Returns false (and flags the archive as errored) if the buffer is too short */
+	bool Skip(int64 Length);
+
+protected:
+	C2MReader();
+	void SetBuffer(const uint8* InData, int64 InSize);
+
+	const uint8* Data;
+	int64 Size;
+	int64 Offset;
+	FString ArchiveName;
+};
+
+/**
+* C2MReader backed by a file on disk.
+* The file is memory-mapped when the platform allows it, otherwise it is loaded into an owned buffer.
+*/
+class C2MODEL_API C2MFileReader : public C2MReader
+{
+public:
+	C2MFileReader();
+	virtual ~C2MFileReader() override;
+
+	bool Open(const FString& Filename);
+	bool IsMapped() const { return MappedRegion.IsValid(); }
+	virtual bool Close() override;
+
+private:
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	TArray64<uint8> FallbackData;
+};
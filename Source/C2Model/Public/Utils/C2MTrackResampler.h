@@ -0,0 +1,35 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+* Turns sparse keyframe tracks (frame array + value array) into dense tracks with one sample per frame.
+* Frames before the first key hold it, frames between two keys are interpolated.
+*/
+class C2MODEL_API C2MTrackResampler
+{
+public:
+	/* Number of dense samples a sparse track bakes to: one per frame up to its last key */
+	static int32 GetDenseLength(TArrayView<const uint32> Frames);
+	/* Linear interpolation, Out must hold GetDenseLength(Frames) samples */
+	static void ResampleVectors(TArrayView<const uint32> Frames, TArrayView<const FVector3f> Values, TArrayView<FVector3f> Out);
+	/* Normalized shortest path nlerp, Out must hold GetDenseLength(Frames) samples */
+	static void ResampleRotations(TArrayView<const uint32> Frames, TArrayView<const FQuat4f> Values, TArrayView<FQuat4f> Out);
+
+	/* Extend a dense track to Length samples by repeating its last sample, or Default when it is empty */
+	template <typename T>
+	static void PadTrack(TArray<T>& Track, int32 Length, const T& Default)
+	{
+		const int32 Start = Track.Num();
+		if (Start >= Length)
+		{
+			return;
+		}
+		const T Fill = Start > 0 ? Track[Start - 1] : Default;
+		Track.SetNumUninitialized(Length);
+		for (int32 i = Start; i < Length; i++)
+		{
+			Track[i] = Fill;
+		}
+	}
+};
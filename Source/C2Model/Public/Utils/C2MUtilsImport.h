@@ -4,4 +4,15 @@ class C2MUtilsImport
 {
 public:
 	static FVector3f ConvertDir(FVector3f Vector);
+	/* Negate Y on every vector in place (COD -> Unreal handedness) */
+	static void FlipY(TArrayView<FVector3f> Vectors);
+	/* Mirror rotations the same way in place: (X, Y, Z, W) -> (-X, Y, -Z, W).
+	 * Same rotation as negating Yaw and Roll of the rotator, without the trig round trip */
+	static void FlipRotationsY(TArrayView<FQuat4f> Rotations);
+	static FQuat4f FlipRotationY(const FQuat4f& Rotation);
+	/* Zero-extend Count packed 8 or 16 bit indices (no alignment required) into 32 bit indices */
+	static void WidenIndices8(const uint8* Source, int64 Count, uint32* OutIndices);
+	static void WidenIndices16(const uint8* Source, int64 Count, uint32* OutIndices);
+	/* Reverse the winding of FaceCount triangles and add BaseVertex to every index, in place */
+	static void ReverseWindingAndOffset(uint32* Indices, int64 FaceCount, uint32 BaseVertex);
 };
\ No newline at end of file